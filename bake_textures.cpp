@@ -0,0 +1,135 @@
+/**
+ * -- Texture Baking (build step) --
+ * Turns a jpg/png into a .baked file (see texture_format.h): decoded, flipped for OpenGL if asked, with the whole
+ * mip chain made here instead of by glGenerateMipmap at launch. The Makefile runs it for each lesson texture.
+ *
+ * Usage: ./bake_textures [--flip] [--filter box|kaiser|lanczos] [--gamma] [--compress bc1|bc3|bc7] <input image> <output.baked>
+ *
+ * Mips come from mip_generator.h. --gamma filters color in linear light, which is what you want for anything that's
+ * a picture (but not for normal maps & the like). --compress stores every level as BC blocks (texture_compression.h).
+ */
+#include "stbi_arena.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "texture_format.h"
+#include "mip_generator.h"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    int arg = 1;
+    bool flip = false;
+    MipOptions mipOptions;
+    TextureCompression compression = TEXTURE_UNCOMPRESSED;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        std::string option = argv[arg];
+        if (option == "--flip")
+        {
+            flip = true;
+        }
+        else if (option == "--gamma")
+        {
+            mipOptions.gammaCorrect = true;
+        }
+        else if (option == "--filter" && arg + 1 < argc)
+        {
+            std::string filter = argv[++arg];
+            mipOptions.filter = filter == "kaiser" ? MIP_FILTER_KAISER : filter == "lanczos" ? MIP_FILTER_LANCZOS : MIP_FILTER_BOX;
+        }
+        else if (option == "--compress" && arg + 1 < argc)
+        {
+            std::string format = argv[++arg];
+            compression = format == "bc1" ? TEXTURE_BC1 : format == "bc3" ? TEXTURE_BC3 : format == "bc7" ? TEXTURE_BC7 : TEXTURE_UNCOMPRESSED;
+        }
+        else
+        {
+            arg = argc;
+        }
+    }
+    if (argc - arg != 2)
+    {
+        std::cout << "Usage: " << argv[0] << " [--flip] [--filter box|kaiser|lanczos] [--gamma] [--compress bc1|bc3|bc7] <input image> <output.baked>" << std::endl;
+        return 1;
+    }
+    const char* inputPath = argv[arg];
+    const char* outputPath = argv[arg + 1];
+
+    stbi_set_flip_vertically_on_load(flip);
+    MipLevelData base;
+    int channels;
+    unsigned char* data = stbi_load(inputPath, &base.width, &base.height, &channels, 0);
+    if (data == NULL)
+    {
+        std::cout << "ERROR::BAKE::LOAD_FAILED " << inputPath << ": " << stbi_failure_reason() << std::endl;
+        return 1;
+    }
+    base.pixels.assign(data, data + (std::size_t)base.width * base.height * channels);
+    stbi_image_free(data);
+
+    std::vector<MipLevelData> levels = generateMipChain(base.pixels.data(), base.width, base.height, channels, MIP_UNORM8, mipOptions);
+    levels.insert(levels.begin(), std::move(base));
+    if (compression != TEXTURE_UNCOMPRESSED)
+    {
+        for (MipLevelData &level : levels)
+        {
+            level.pixels = compressTexture(level.pixels.data(), level.width, level.height, channels, compression);
+        }
+    }
+
+    // Sized internal formats (like chooseTextureFormat in texture_upload.h, there's no GL here to ask what it prefers)
+    const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    const GLenum sizedFormats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    BakedTextureHeader header;
+    std::memcpy(header.magic, BAKED_TEXTURE_MAGIC, sizeof(header.magic));
+    header.format = formats[channels - 1];
+    header.internalFormat = compression != TEXTURE_UNCOMPRESSED ? compressedGLFormat(compression) : sizedFormats[channels - 1];
+    header.type = GL_UNSIGNED_BYTE;
+    header.width = levels[0].width;
+    header.height = levels[0].height;
+    header.levels = (std::uint32_t)levels.size();
+    header.channels = channels;
+    header.compression = compression;
+
+    std::vector<BakedTextureLevel> table;
+    std::uint64_t offset = bakedTextureDataStart(header.levels);
+    for (const MipLevelData &level : levels)
+    {
+        table.push_back(BakedTextureLevel{(std::uint32_t)level.width, (std::uint32_t)level.height, offset, level.pixels.size()});
+        offset = (offset + level.pixels.size() + 15) / 16 * 16;
+    }
+
+    // Write to a temp file & rename, so a half written file never ends up where the lesson looks for it.
+    std::string tempPath = std::string(outputPath) + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (file == NULL)
+    {
+        std::cout << "ERROR::BAKE::CANNOT_WRITE " << outputPath << std::endl;
+        return 1;
+    }
+    const char padding[16] = {0};
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fwrite(table.data(), sizeof(BakedTextureLevel), table.size(), file);
+    long written = (long)(sizeof(header) + table.size() * sizeof(BakedTextureLevel));
+    for (std::size_t i = 0; i < levels.size(); i++)
+    {
+        std::fwrite(padding, 1, table[i].offset - written, file);
+        std::fwrite(levels[i].pixels.data(), 1, levels[i].pixels.size(), file);
+        written = (long)(table[i].offset + table[i].size);
+    }
+    bool failed = std::ferror(file) != 0;
+    failed = std::fclose(file) != 0 || failed;
+    if (failed || std::rename(tempPath.c_str(), outputPath) != 0)
+    {
+        std::cout << "ERROR::BAKE::CANNOT_WRITE " << outputPath << std::endl;
+        std::remove(tempPath.c_str());
+        return 1;
+    }
+
+    std::cout << "BAKE " << inputPath << " -> " << outputPath << " (" << header.width << "x" << header.height << ", " << channels << " channels, " << levels.size() << " levels, " << (offset >> 10) << "KB)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,42 @@
+#! /bin/sh
+# Writes embedded_shaders.h: every .vs/.fs/.glsl in the repo as constexpr data, keyed by the same
+# path the lessons pass to Shader. Build a lesson with -DEMBED_SHADERS to use it, e.g.
+#   make embed && ./run.sh shader_lesson/shaders.cpp -DEMBED_SHADERS
+out=embedded_shaders.h
+
+{
+    echo "// Generated by embed_shaders.sh. Don't edit, run \`make embed\` again instead."
+    echo "#ifndef EMBEDDED_SHADERS_H"
+    echo "#define EMBEDDED_SHADERS_H"
+    echo ""
+    echo "#include <cstddef>"
+    echo ""
+    echo "struct EmbeddedShader"
+    echo "{"
+    echo "    const char* path;"
+    echo "    const char* code;"
+    echo "    std::size_t length;"
+    echo "};"
+    echo ""
+
+    i=0
+    for file in $(find . -name '*.vs' -o -name '*.fs' -o -name '*.glsl' | sed 's|^\./||' | sort)
+    do
+        printf 'constexpr char EMBEDDED_SHADER_%d[] = R"glsl(' "$i"
+        cat "$file"
+        printf ')glsl";\n'
+        i=$((i + 1))
+    done
+
+    echo ""
+    echo "constexpr EmbeddedShader EMBEDDED_SHADERS[] = {"
+    i=0
+    for file in $(find . -name '*.vs' -o -name '*.fs' -o -name '*.glsl' | sed 's|^\./||' | sort)
+    do
+        printf '    {"%s", EMBEDDED_SHADER_%d, sizeof(EMBEDDED_SHADER_%d) - 1},\n' "$file" "$i" "$i"
+        i=$((i + 1))
+    done
+    echo "};"
+    echo ""
+    echo "#endif"
+} > "$out"
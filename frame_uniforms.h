@@ -0,0 +1,25 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include "uniform_buffer.h"
+
+/**
+ * -- Per-Frame Uniforms --
+ * The C++ half of shader_lesson/frame_uniforms.glsl, which basic.vs includes, so every lesson program declares it.
+ * Each lesson makes one UniformBuffer<FrameUniforms> on FRAME_UNIFORMS_BINDING, hooks each program up to it once
+ * with Shader::bindUniformBlock, and update()s it once per frame. One upload, every program sees it.
+ *
+ * Usage:
+ *     UniformBuffer<FrameUniforms> frameUniforms(FRAME_UNIFORMS_BINDING, 3);
+ *     shaderProgram.bindUniformBlock(frameUniforms);
+ *     ...every frame...
+ *     frameData.time = (float)glfwGetTime();
+ *     frameUniforms.update(frameData);
+ */
+#define FRAME_UNIFORMS(MEMBER) \
+    MEMBER(float, time)
+STD140_BLOCK(FrameUniforms, FRAME_UNIFORMS)
+
+const unsigned int FRAME_UNIFORMS_BINDING = 0;
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+/**
+ * Our glad.c was generated for plain GL 3.3 core with no extensions, so anything newer has to be loaded by hand.
+ * Call loadGLExtensions((GLADloadproc) glfwGetProcAddress) right after gladLoadGLLoader.
+ * If it's never called every flag stays false and the code using it takes the plain 3.3 path.
+ */
+
+// Enums that glad doesn't know about
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#define GL_INTERNALFORMAT_PREFERRED 0x8270
+#define GL_TEXTURE_IMAGE_FORMAT 0x828F
+#define GL_TEXTURE_IMAGE_TYPE 0x8290
+
+typedef void (APIENTRYP LOADGL_GETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP LOADGL_PROGRAMBINARY)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP LOADGL_PROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP LOADGL_MAXSHADERCOMPILERTHREADS)(GLuint count);
+typedef void (APIENTRYP LOADGL_GETINTERNALFORMATIV)(GLenum target, GLenum internalformat, GLenum pname, GLsizei count, GLint *params);
+typedef void (APIENTRYP LOADGL_TEXSTORAGE2D)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP LOADGL_TEXSTORAGE3D)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+
+struct GLExtensions
+{
+    // GL_ARB_get_program_binary (core in 4.1)
+    bool programBinary = false;
+    LOADGL_GETPROGRAMBINARY GetProgramBinary = NULL;
+    LOADGL_PROGRAMBINARY ProgramBinary = NULL;
+    LOADGL_PROGRAMPARAMETERI ProgramParameteri = NULL;
+
+    // GL_KHR_parallel_shader_compile (or the ARB version). Lets us poll GL_COMPLETION_STATUS_KHR without blocking.
+    bool parallelShaderCompile = false;
+    LOADGL_MAXSHADERCOMPILERTHREADS MaxShaderCompilerThreads = NULL;
+
+    // GL_EXT_texture_compression_s3tc => BC1/BC3 (DXT1/DXT5), GL_ARB_texture_compression_bptc (core in 4.2) => BC7.
+    // Both only add enums, uploads go through glCompressedTexImage2D which 3.3 already has.
+    bool textureCompressionS3TC = false;
+    bool textureCompressionBPTC = false;
+
+    // GL_ARB_internalformat_query2 (core in 4.3). Asks the driver how it really stores an internal format & which
+    // source format/type it can copy from without converting (see texture_upload.h).
+    bool internalformatQuery2 = false;
+    LOADGL_GETINTERNALFORMATIV GetInternalformativ = NULL;
+
+    // GL_ARB_texture_storage (core in 4.2). Allocates every mip level of a texture in one call & fixes its size and
+    // format for good, so the driver never has to check it for completeness again (see allocateTextureStorage).
+    bool textureStorage = false;
+    LOADGL_TEXSTORAGE2D TexStorage2D = NULL;
+    LOADGL_TEXSTORAGE3D TexStorage3D = NULL;
+};
+
+inline GLExtensions GLExt;
+
+/**
+ * Checks the extension list of the current context. glGetString(GL_EXTENSIONS) is gone in core profile,
+ * so we have to walk them one at a time with glGetStringi.
+ */
+inline bool hasGLExtension(const char* name)
+{
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (extension != NULL && std::strcmp(extension, name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void loadGLExtensions(GLADloadproc load)
+{
+    GLExt = GLExtensions();
+
+    if (hasGLExtension("GL_ARB_get_program_binary"))
+    {
+        GLExt.GetProgramBinary = (LOADGL_GETPROGRAMBINARY)load("glGetProgramBinary");
+        GLExt.ProgramBinary = (LOADGL_PROGRAMBINARY)load("glProgramBinary");
+        GLExt.ProgramParameteri = (LOADGL_PROGRAMPARAMETERI)load("glProgramParameteri");
+
+        // Some drivers (older Mesa) expose the extension but support zero binary formats, which makes it useless.
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        GLExt.programBinary = formats > 0 && GLExt.GetProgramBinary && GLExt.ProgramBinary && GLExt.ProgramParameteri;
+    }
+
+    // Both extensions share the same enums, only the function name differs.
+    if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+    {
+        GLExt.MaxShaderCompilerThreads = (LOADGL_MAXSHADERCOMPILERTHREADS)load("glMaxShaderCompilerThreadsKHR");
+    }
+    else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+    {
+        GLExt.MaxShaderCompilerThreads = (LOADGL_MAXSHADERCOMPILERTHREADS)load("glMaxShaderCompilerThreadsARB");
+    }
+    GLExt.parallelShaderCompile = GLExt.MaxShaderCompilerThreads != NULL;
+
+    GLExt.textureCompressionS3TC = hasGLExtension("GL_EXT_texture_compression_s3tc");
+    GLExt.textureCompressionBPTC = hasGLExtension("GL_ARB_texture_compression_bptc");
+
+    if (hasGLExtension("GL_ARB_internalformat_query2"))
+    {
+        GLExt.GetInternalformativ = (LOADGL_GETINTERNALFORMATIV)load("glGetInternalformativ");
+        GLExt.internalformatQuery2 = GLExt.GetInternalformativ != NULL;
+    }
+
+    // A 4.2+ context has it in core even if the driver doesn't list the extension
+    int major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 2) || hasGLExtension("GL_ARB_texture_storage"))
+    {
+        GLExt.TexStorage2D = (LOADGL_TEXSTORAGE2D)load("glTexStorage2D");
+        GLExt.TexStorage3D = (LOADGL_TEXSTORAGE3D)load("glTexStorage3D");
+        GLExt.textureStorage = GLExt.TexStorage2D != NULL && GLExt.TexStorage3D != NULL;
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * -- Image Loading Benchmark --
+ * Decodes the lesson images (each one many times over, so there's enough work to split) with loadImages on
+ * 1, 2, 4, ... threads and prints MB/s & images/s for each. Run with `make bench`.
+ * Afterwards it prints how many allocations stb_image made, how many reached the heap & the peak RSS.
+ * --no-arena turns stbi_arena.h off, to compare (make bench runs both).
+ * `make bench-png` builds it twice, with & without -DSTBI_NO_FAST_INFLATE, and runs both on PNG_CORPUS, to compare
+ * the zlib decoder against the old symbol at a time one.
+ * --cold drops the files from the page cache before every run, so they're read off the disk (`make bench-cold` runs
+ * that on 500 copies of the lesson images). --no-mmap reads files with read() instead of mapping them & --no-prefetch
+ * turns off reading ahead, to compare.
+ *
+ * Usage: ./image_benchmark [--no-arena] [--no-mmap] [--no-prefetch] [--cold] [repeats] [image...]
+ */
+#include "stbi_arena.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "image_loader.h"
+
+#include <cstdlib>
+
+int main(int argc, char** argv)
+{
+    int arg = 1;
+    bool cold = false;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        std::string option = argv[arg];
+        if (option == "--no-arena")
+        {
+            stbiArenaEnabled = false;
+        }
+        else if (option == "--no-mmap")
+        {
+            imageMmapEnabled = false;
+        }
+        else if (option == "--no-prefetch")
+        {
+            imagePrefetchDistance = 0;
+        }
+        else if (option == "--cold")
+        {
+            cold = true;
+        }
+    }
+    int repeats = arg < argc ? std::atoi(argv[arg++]) : 64;
+    std::vector<std::string> paths;
+    for (int i = arg; i < argc; i++)
+    {
+        paths.push_back(argv[i]);
+    }
+    if (paths.empty())
+    {
+        paths = {"texture_lesson/container.jpg", "texture_lesson/wall.jpg", "texture_lesson/awesomeface.png"};
+    }
+
+    std::vector<ImageRequest> requests;
+    for (int r = 0; r < repeats; r++)
+    {
+        for (const std::string &path : paths)
+        {
+            // Alternate the flip so threads really do want different settings at the same time
+            ImageRequest request;
+            request.path = path;
+            request.flip = (requests.size() % 2) == 1;
+            requests.push_back(request);
+        }
+    }
+#ifdef STBI_NO_FAST_INFLATE
+    const char* inflate = "careful";
+#else
+    const char* inflate = "fast";
+#endif
+    std::cout << "IMAGE::BENCHMARK arena " << (stbiArenaEnabled ? "on" : "off") << ", " << inflate << " inflate, "
+              << (imageMmapEnabled ? "mmap" : "read()") << ", prefetch " << (imagePrefetchDistance > 0 ? "on" : "off") << (cold ? ", cold" : "") << std::endl;
+    // 16 at a time, then they're dropped, like textures that have been uploaded
+    benchmarkImageLoading(requests, 16, cold);
+    stbiArenaStats.print();
+    return 0;
+}
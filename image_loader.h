@@ -0,0 +1,343 @@
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+// The lesson includes stb_image.h first (with STB_IMAGE_IMPLEMENTATION), including it again would define everything twice.
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include "stb_image.h"
+#endif
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * -- Batch Image Loading --
+ * Decodes a list of images on a pool of threads. stbi_set_flip_vertically_on_load(true) flips for every thread in
+ * the process, so two threads wanting different orientations would race. Every job here sets the per-thread version
+ * (stbi_set_flip_vertically_on_load_thread) for itself instead, along with how many channels it wants.
+ *
+ * Results come back in the same order as the requests, whichever thread finished first.
+ *
+ * Files are mmap'd (MappedFile below) and stbi decodes straight out of the mapping, so the bytes never get copied
+ * into a buffer of ours first. While a thread works on request i, it also asks the kernel to start reading request
+ * i + imagePrefetchDistance (prefetchFile), so by the time a thread gets there the file is already in memory instead
+ * of being read from disk while the thread waits.
+ *
+ * Usage:
+ *     std::vector<ImageRequest> requests = {{"texture_lesson/container.jpg"}, {"texture_lesson/awesomeface.png", true, 4}};
+ *     ImageLoadStats stats;
+ *     std::vector<LoadedImage> images = loadImages(requests, 0, &stats);
+ *     stats.print();
+ */
+
+struct ImageRequest
+{
+    std::string path;
+    bool flip = false;
+    int channels = 0; // 0 = whatever the file has, like stbi_load's last argument
+    bool expandRGB = false; // With channels = 0: 3 channel files come out as RGBA (when the GPU would pad them anyway, see texture_upload.h)
+};
+
+struct StbiImageDeleter
+{
+    void operator()(unsigned char* pixels) const { stbi_image_free(pixels); }
+};
+
+struct LoadedImage
+{
+    std::unique_ptr<unsigned char, StbiImageDeleter> pixels; // NULL if the load failed
+    int width = 0;
+    int height = 0;
+    int channels = 0;      // Channels in `pixels`, i.e. the requested count if there was one
+    std::size_t fileBytes = 0;
+};
+
+struct ImageLoadStats
+{
+    int images = 0;
+    int threads = 0;
+    std::size_t fileBytes = 0;  // Compressed, as read from disk
+    std::size_t pixelBytes = 0; // Decoded
+    double seconds = 0.0;
+
+    double megabytesPerSecond() const { return seconds > 0.0 ? fileBytes / (1024.0 * 1024.0) / seconds : 0.0; }
+    double imagesPerSecond() const { return seconds > 0.0 ? images / seconds : 0.0; }
+
+    void print() const
+    {
+        std::cout << "IMAGE::LOAD " << images << " images on " << threads << " threads in " << seconds * 1000.0 << "ms: "
+                  << megabytesPerSecond() << " MB/s, " << imagesPerSecond() << " images/s" << std::endl;
+    }
+};
+
+// Both on by default, off is for comparing (image_benchmark --no-mmap / --no-prefetch)
+inline bool imageMmapEnabled = true;
+inline std::size_t imagePrefetchDistance = 16; // Requests ahead of the ones being decoded, 0 = no prefetching
+
+/**
+ * A whole file mmap'd read only. madvise tells the kernel how it's about to be used:
+ *   MADV_SEQUENTIAL - read front to back (which is how stbi goes through it), so read ahead a lot & don't bother
+ *                     keeping pages around once we're past them.
+ *   MADV_WILLNEED   - start reading all of it in now, instead of one page fault at a time as stbi gets there.
+ * Unmapped when it goes out of scope.
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* data() const { return (const unsigned char*)mapped; }
+    std::size_t size() const { return bytes; }
+
+private:
+    void* mapped = NULL;
+    std::size_t bytes = 0;
+};
+
+inline bool MappedFile::open(const char* path)
+{
+    close();
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return false;
+    }
+    struct stat info;
+    // mmap can't do empty files, and stbi couldn't do anything with one anyway
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void* result = mmap(NULL, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (result == MAP_FAILED)
+    {
+        return false;
+    }
+    mapped = result;
+    bytes = (std::size_t)info.st_size;
+    madvise(mapped, bytes, MADV_SEQUENTIAL);
+    madvise(mapped, bytes, MADV_WILLNEED);
+    return true;
+}
+
+inline void MappedFile::close()
+{
+    if (mapped != NULL)
+    {
+        munmap(mapped, bytes);
+        mapped = NULL;
+        bytes = 0;
+    }
+}
+
+/**
+ * Starts reading a file into the page cache without waiting for it (POSIX_FADV_WILLNEED), for a file that's going to
+ * be loaded soon. Costs an open & close, the reading happens in the background.
+ */
+inline void prefetchFile(const char* path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+}
+
+/**
+ * The opposite, drops a file's pages from the page cache so the next load has to go to the disk. Only for measuring
+ * cold starts, see benchmarkImageLoading.
+ */
+inline void evictFile(const char* path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1)
+    {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+// Whole file in one read(), like readShaderFile but for binary data. The imageMmapEnabled = false path.
+inline bool readTextureFile(const char* path, std::vector<unsigned char> &out)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    out.resize((std::size_t)info.st_size);
+    ssize_t got = out.empty() ? 0 : read(fd, out.data(), out.size());
+    close(fd);
+    return got == (ssize_t)out.size();
+}
+
+// One job, on whatever thread calls it. `file` is scratch space for when mmap is off, reused between jobs on the same thread.
+inline LoadedImage loadImage(const ImageRequest &request, std::vector<unsigned char> &file)
+{
+    LoadedImage image;
+    MappedFile mapped;
+    const unsigned char* bytes = NULL;
+    std::size_t size = 0;
+    if (imageMmapEnabled ? mapped.open(request.path.c_str()) : readTextureFile(request.path.c_str(), file))
+    {
+        bytes = imageMmapEnabled ? mapped.data() : file.data();
+        size = imageMmapEnabled ? mapped.size() : file.size();
+    }
+    if (bytes == NULL)
+    {
+        std::cout << "ERROR::IMAGE::FILE_NOT_READ " << request.path << std::endl;
+        return image;
+    }
+    image.fileBytes = size;
+    stbi_set_flip_vertically_on_load_thread(request.flip);
+    int channels = request.channels;
+    int fileChannels = 0;
+    if (channels == 0 && request.expandRGB && stbi_info_from_memory(bytes, (int)size, &image.width, &image.height, &fileChannels) && fileChannels == 3)
+    {
+        channels = 4; // stbi adds the alpha while it's converting anyway
+    }
+    image.pixels.reset(stbi_load_from_memory(bytes, (int)size, &image.width, &image.height, &fileChannels, channels));
+    if (!image.pixels)
+    {
+        std::cout << "ERROR::IMAGE::DECODE_FAILED " << request.path << ": " << stbi_failure_reason() << std::endl;
+        return image;
+    }
+    image.channels = channels != 0 ? channels : fileChannels;
+    return image;
+}
+
+/**
+ * Decodes every request on `threads` threads (0 = one per core) & returns them in request order.
+ * Threads grab the next unclaimed request as they go, so one huge image doesn't hold up a whole share of the list.
+ */
+inline std::vector<LoadedImage> loadImages(const ImageRequest* requests, std::size_t count, int threads = 0, ImageLoadStats* stats = NULL)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<LoadedImage> images(count);
+    if (threads <= 0)
+    {
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    threads = (int)std::min<std::size_t>(threads, count);
+
+    // The first few get read as soon as a thread picks them, start on the ones right after
+    for (std::size_t i = (std::size_t)threads; i < std::min(imagePrefetchDistance, count); i++)
+    {
+        prefetchFile(requests[i].path.c_str());
+    }
+    std::atomic<std::size_t> next(0);
+    auto work = [&]()
+    {
+        std::vector<unsigned char> file;
+        for (std::size_t i = next++; i < count; i = next++)
+        {
+            if (imagePrefetchDistance > 0 && i + imagePrefetchDistance < count)
+            {
+                prefetchFile(requests[i + imagePrefetchDistance].path.c_str());
+            }
+            images[i] = loadImage(requests[i], file);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++)
+    {
+        pool.push_back(std::thread(work));
+    }
+    work();
+    for (std::thread &thread : pool)
+    {
+        thread.join();
+    }
+
+    if (stats != NULL)
+    {
+        *stats = ImageLoadStats();
+        stats->threads = std::max(threads, 1);
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (const LoadedImage &image : images)
+        {
+            stats->images += image.pixels ? 1 : 0;
+            stats->fileBytes += image.fileBytes;
+            stats->pixelBytes += image.pixels ? (std::size_t)image.width * image.height * image.channels : 0;
+        }
+    }
+    return images;
+}
+
+inline std::vector<LoadedImage> loadImages(const std::vector<ImageRequest> &requests, int threads = 0, ImageLoadStats* stats = NULL)
+{
+    return loadImages(requests.data(), requests.size(), threads, stats);
+}
+
+/**
+ * Loads the same requests with 1, 2, 4, ... threads up to one per core & prints the throughput of each,
+ * to see how well decoding scales on this machine.
+ * batch > 0 decodes `batch` images at a time & drops them before the next lot, like the streamer does once it has
+ * uploaded them. 0 keeps every image until the end.
+ * cold evicts every file from the page cache before each run (evictFile), so the files come off the disk like on a
+ * fresh boot instead of out of memory. Use a corpus of distinct files for that, repeats of one file only miss once.
+ */
+inline void benchmarkImageLoading(const std::vector<ImageRequest> &requests, std::size_t batch = 0, bool cold = false)
+{
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    if (batch == 0)
+    {
+        batch = requests.size();
+    }
+    for (int threads = 1; ; threads = std::min(threads * 2, cores))
+    {
+        ImageLoadStats total;
+        for (std::size_t i = 0; cold && i < requests.size(); i++)
+        {
+            evictFile(requests[i].path.c_str());
+        }
+        for (std::size_t first = 0; first < requests.size(); first += batch)
+        {
+            // Have the next lot on its way in while this one decodes, like the streamer with its queue
+            for (std::size_t i = first + batch; imagePrefetchDistance > 0 && i < std::min(first + 2 * batch, requests.size()); i++)
+            {
+                prefetchFile(requests[i].path.c_str());
+            }
+            ImageLoadStats stats;
+            loadImages(requests.data() + first, std::min(batch, requests.size() - first), threads, &stats);
+            total.images += stats.images;
+            total.threads = std::max(total.threads, stats.threads);
+            total.fileBytes += stats.fileBytes;
+            total.pixelBytes += stats.pixelBytes;
+            total.seconds += stats.seconds;
+        }
+        total.print();
+        if (threads == cores)
+        {
+            break;
+        }
+    }
+}
+
+#endif
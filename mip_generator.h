@@ -0,0 +1,422 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIP_X86 1
+#endif
+
+/**
+ * -- CPU Mip Generation --
+ * glGenerateMipmap is whatever the driver feels like: usually a plain box filter, often not gamma correct, and slow
+ * on software drivers like llvmpipe. This makes the whole chain on the CPU instead, so it can run on a worker thread
+ * (TextureStreamer) or ahead of time (bake_textures), with a choice of filter:
+ *   Box     - average of each 2x2, what drivers do. Fast, a bit blurry & can alias.
+ *   Kaiser  - Kaiser windowed sinc, 3 texel radius. Sharper with little ringing, a good default for color textures.
+ *   Lanczos - Lanczos-3. Sharpest, but rings a little around hard edges.
+ *
+ * gammaCorrect treats 8 bit color channels as sRGB: decoded to linear light, filtered, encoded back. Averaging sRGB
+ * values directly makes mips darker than they should be (the average of black & white comes out as 50% sRGB, which
+ * is only ~21% of the light). Alpha is always linear.
+ *
+ * Every level is filtered from the previous one in float (never re-quantized in between), horizontally then
+ * vertically. Rows are split across threads. Levels can't be, each one needs the one before it, so once a level
+ * is small enough that threads cost more than they save the rest of the chain just runs on the calling thread.
+ * The inner loops use SSE2, and AVX2 when the CPU has it (checked at runtime).
+ */
+
+enum MipFilter
+{
+    MIP_FILTER_BOX,
+    MIP_FILTER_KAISER,
+    MIP_FILTER_LANCZOS
+};
+
+enum MipPixelType
+{
+    MIP_UNORM8,  // unsigned char per channel
+    MIP_UNORM16, // unsigned short per channel
+    MIP_FLOAT32  // float per channel
+};
+
+struct MipOptions
+{
+    MipFilter filter = MIP_FILTER_BOX;
+    bool gammaCorrect = false; // Only for MIP_UNORM8
+    int threads = 0;           // 0 = one per core
+};
+
+struct MipLevelData
+{
+    int width;
+    int height;
+    std::vector<unsigned char> pixels; // Same pixel type & channel count as the input, rows tightly packed
+};
+
+inline int mipPixelTypeBytes(MipPixelType type)
+{
+    return type == MIP_UNORM8 ? 1 : type == MIP_UNORM16 ? 2 : 4;
+}
+
+// -- Filters --
+
+inline float mipSinc(float x)
+{
+    if (std::fabs(x) < 1e-5f)
+    {
+        return 1.0f;
+    }
+    x *= 3.14159265358979f;
+    return std::sin(x) / x;
+}
+
+// Modified Bessel function of the first kind, order 0. The series converges quickly for the alphas we use.
+inline float mipBesselI0(float x)
+{
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; k++)
+    {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+inline float mipFilterRadius(MipFilter filter)
+{
+    return filter == MIP_FILTER_BOX ? 0.5f : 3.0f;
+}
+
+// Filter value `x` source texels (in destination scale) away from the center
+inline float mipFilterWeight(MipFilter filter, float x)
+{
+    float radius = mipFilterRadius(filter);
+    if (std::fabs(x) > radius)
+    {
+        return 0.0f;
+    }
+    switch (filter)
+    {
+    case MIP_FILTER_BOX:
+        return 1.0f;
+    case MIP_FILTER_KAISER:
+    {
+        const float alpha = 4.0f;
+        float t = x / radius;
+        return mipSinc(x) * mipBesselI0(alpha * std::sqrt(1.0f - t * t)) / mipBesselI0(alpha);
+    }
+    case MIP_FILTER_LANCZOS:
+    default:
+        return mipSinc(x) * mipSinc(x / radius);
+    }
+}
+
+/**
+ * Which source texels (clamped at the edges) & weights make each destination texel along one axis.
+ * Every destination texel gets the same number of taps (padded with zero weights) to keep the loops simple.
+ */
+struct MipKernel
+{
+    int taps;
+    std::vector<int> index;
+    std::vector<float> weight;
+};
+
+inline MipKernel makeMipKernel(int sourceSize, int destinationSize, MipFilter filter)
+{
+    MipKernel kernel;
+    float scale = (float)sourceSize / destinationSize;
+    float support = mipFilterRadius(filter) * scale;
+    kernel.taps = (int)std::ceil(support * 2.0f) + 1;
+    kernel.index.assign((std::size_t)destinationSize * kernel.taps, 0);
+    kernel.weight.assign((std::size_t)destinationSize * kernel.taps, 0.0f);
+
+    for (int i = 0; i < destinationSize; i++)
+    {
+        // Texel j covers [j, j + 1], so its center is j + 0.5
+        float center = (i + 0.5f) * scale;
+        int first = (int)std::floor(center - support);
+        float total = 0.0f;
+        for (int t = 0; t < kernel.taps; t++)
+        {
+            int j = first + t;
+            float w = mipFilterWeight(filter, (j + 0.5f - center) / scale);
+            kernel.index[(std::size_t)i * kernel.taps + t] = std::min(std::max(j, 0), sourceSize - 1);
+            kernel.weight[(std::size_t)i * kernel.taps + t] = w;
+            total += w;
+        }
+        for (int t = 0; t < kernel.taps; t++)
+        {
+            kernel.weight[(std::size_t)i * kernel.taps + t] /= total;
+        }
+    }
+    return kernel;
+}
+
+// -- SIMD kernels --
+
+// out[i] += w * in[i] for a whole row. This is the vertical pass, which is where most of the time goes.
+inline void mipAccumulateRowScalar(float* out, const float* in, float w, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        out[i] += w * in[i];
+    }
+}
+
+#ifdef MIP_X86
+inline void mipAccumulateRowSSE2(float* out, const float* in, float w, int count)
+{
+    __m128 weight = _mm_set1_ps(w);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(weight, _mm_loadu_ps(in + i))));
+    }
+    mipAccumulateRowScalar(out + i, in + i, w, count - i);
+}
+
+__attribute__((target("avx2")))
+inline void mipAccumulateRowAVX2(float* out, const float* in, float w, int count)
+{
+    __m256 weight = _mm256_set1_ps(w);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(weight, _mm256_loadu_ps(in + i))));
+    }
+    mipAccumulateRowSSE2(out + i, in + i, w, count - i);
+}
+#endif
+
+typedef void (*MipAccumulateRow)(float* out, const float* in, float w, int count);
+
+inline MipAccumulateRow mipPickAccumulateRow()
+{
+#ifdef MIP_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return mipAccumulateRowAVX2;
+    }
+    return mipAccumulateRowSSE2;
+#else
+    return mipAccumulateRowScalar;
+#endif
+}
+
+// Horizontal pass for one row. RGBA is one texel per SSE register, so that case gets its own loop.
+inline void mipFilterRowHorizontal(float* out, const float* in, const MipKernel &kernel, int destinationWidth, int channels)
+{
+#ifdef MIP_X86
+    if (channels == 4)
+    {
+        for (int x = 0; x < destinationWidth; x++)
+        {
+            const int* index = &kernel.index[(std::size_t)x * kernel.taps];
+            const float* weight = &kernel.weight[(std::size_t)x * kernel.taps];
+            __m128 sum = _mm_setzero_ps();
+            for (int t = 0; t < kernel.taps; t++)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight[t]), _mm_loadu_ps(in + index[t] * 4)));
+            }
+            _mm_storeu_ps(out + x * 4, sum);
+        }
+        return;
+    }
+#endif
+    for (int x = 0; x < destinationWidth; x++)
+    {
+        const int* index = &kernel.index[(std::size_t)x * kernel.taps];
+        const float* weight = &kernel.weight[(std::size_t)x * kernel.taps];
+        for (int c = 0; c < channels; c++)
+        {
+            float sum = 0.0f;
+            for (int t = 0; t < kernel.taps; t++)
+            {
+                sum += weight[t] * in[index[t] * channels + c];
+            }
+            out[x * channels + c] = sum;
+        }
+    }
+}
+
+// -- Threads --
+
+// Runs work(begin, end) over [0, rows) split into one chunk per thread. Small jobs stay on this thread.
+template <typename Work>
+void mipParallelRows(int rows, int rowFloats, int threads, const Work &work)
+{
+    const int minimumFloatsPerThread = 64 * 1024;
+    int useful = (int)(((long long)rows * rowFloats) / minimumFloatsPerThread);
+    threads = std::min(std::min(threads, useful), rows);
+    if (threads <= 1)
+    {
+        work(0, rows);
+        return;
+    }
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++)
+    {
+        pool.push_back(std::thread(work, rows * i / threads, rows * (i + 1) / threads));
+    }
+    work(0, rows / threads);
+    for (std::thread &thread : pool)
+    {
+        thread.join();
+    }
+}
+
+// -- Conversion --
+
+inline float mipSRGBToLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float mipLinearToSRGB(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+inline void mipToFloat(const void* pixels, std::size_t count, int channels, MipPixelType type, bool gamma, float* out)
+{
+    if (type == MIP_UNORM8)
+    {
+        float table[2][256]; // [0] linear, [1] sRGB decoded
+        for (int i = 0; i < 256; i++)
+        {
+            table[0][i] = i / 255.0f;
+            table[1][i] = mipSRGBToLinear(i / 255.0f);
+        }
+        const unsigned char* in = (const unsigned char*)pixels;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            bool alpha = channels == 4 && i % 4 == 3;
+            out[i] = table[gamma && !alpha][in[i]];
+        }
+    }
+    else if (type == MIP_UNORM16)
+    {
+        const unsigned short* in = (const unsigned short*)pixels;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            out[i] = in[i] / 65535.0f;
+        }
+    }
+    else
+    {
+        std::memcpy(out, pixels, count * sizeof(float));
+    }
+}
+
+inline void mipFromFloat(const float* in, std::size_t count, int channels, MipPixelType type, bool gamma, unsigned char* pixels)
+{
+    // pow() per channel would be most of the time in a gamma correct chain, so encode through a table built once.
+    // 16K entries keeps it within 1 of calling pow, and only right at rounding boundaries.
+    const int encodeSize = 16384;
+    static const std::vector<unsigned char> encode = []
+    {
+        std::vector<unsigned char> table(encodeSize);
+        for (int i = 0; i < encodeSize; i++)
+        {
+            table[i] = (unsigned char)(mipLinearToSRGB((float)i / (encodeSize - 1)) * 255.0f + 0.5f);
+        }
+        return table;
+    }();
+    for (std::size_t i = 0; i < count; i++)
+    {
+        // Sharper filters overshoot a little around edges, keep unorm values in range
+        float value = in[i];
+        if (type == MIP_FLOAT32)
+        {
+            std::memcpy(pixels + i * sizeof(float), &value, sizeof(float));
+            continue;
+        }
+        value = std::min(std::max(value, 0.0f), 1.0f);
+        if (type == MIP_UNORM8)
+        {
+            bool alpha = channels == 4 && i % 4 == 3;
+            pixels[i] = gamma && !alpha ? encode[(int)(value * (encodeSize - 1) + 0.5f)] : (unsigned char)(value * 255.0f + 0.5f);
+        }
+        else
+        {
+            unsigned short packed = (unsigned short)(value * 65535.0f + 0.5f);
+            std::memcpy(pixels + i * sizeof(packed), &packed, sizeof(packed));
+        }
+    }
+}
+
+/**
+ * Every level below `pixels` (the base level, not included) down to 1x1.
+ * Non power of two sizes are fine, each level is max(1, previous / 2) like GL does it.
+ */
+inline std::vector<MipLevelData> generateMipChain(const void* pixels, int width, int height, int channels, MipPixelType type, const MipOptions &options = MipOptions())
+{
+    std::vector<MipLevelData> levels;
+    if (width <= 0 || height <= 0 || channels < 1 || channels > 4)
+    {
+        return levels;
+    }
+    bool gamma = options.gammaCorrect && type == MIP_UNORM8;
+    int threads = options.threads > 0 ? options.threads : std::max(1, (int)std::thread::hardware_concurrency());
+    MipAccumulateRow accumulateRow = mipPickAccumulateRow();
+
+    std::vector<float> source((std::size_t)width * height * channels);
+    mipToFloat(pixels, source.size(), channels, type, gamma, source.data());
+    std::vector<float> horizontal, destination;
+
+    while (width > 1 || height > 1)
+    {
+        int nextWidth = std::max(1, width / 2);
+        int nextHeight = std::max(1, height / 2);
+        MipKernel columns = makeMipKernel(width, nextWidth, options.filter);
+        MipKernel rows = makeMipKernel(height, nextHeight, options.filter);
+
+        horizontal.assign((std::size_t)nextWidth * height * channels, 0.0f);
+        mipParallelRows(height, nextWidth * channels, threads, [&](int begin, int end)
+        {
+            for (int y = begin; y < end; y++)
+            {
+                mipFilterRowHorizontal(&horizontal[(std::size_t)y * nextWidth * channels], &source[(std::size_t)y * width * channels], columns, nextWidth, channels);
+            }
+        });
+
+        int rowFloats = nextWidth * channels;
+        destination.assign((std::size_t)rowFloats * nextHeight, 0.0f);
+        mipParallelRows(nextHeight, rowFloats, threads, [&](int begin, int end)
+        {
+            for (int y = begin; y < end; y++)
+            {
+                for (int t = 0; t < rows.taps; t++)
+                {
+                    float w = rows.weight[(std::size_t)y * rows.taps + t];
+                    if (w != 0.0f)
+                    {
+                        accumulateRow(&destination[(std::size_t)y * rowFloats], &horizontal[(std::size_t)rows.index[(std::size_t)y * rows.taps + t] * rowFloats], w, rowFloats);
+                    }
+                }
+            }
+        });
+
+        MipLevelData level;
+        level.width = nextWidth;
+        level.height = nextHeight;
+        level.pixels.resize(destination.size() * mipPixelTypeBytes(type));
+        mipFromFloat(destination.data(), destination.size(), channels, type, gamma, level.pixels.data());
+        levels.push_back(std::move(level));
+
+        source.swap(destination);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return levels;
+}
+
+#endif
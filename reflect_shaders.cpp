@@ -0,0 +1,525 @@
+/**
+ * -- Shader Reflection (build step) --
+ * Reads a vertex/fragment pair the same way Shader does (includes + defines, see shader_preprocessor.h), picks out the
+ * vertex attributes & uniforms, and writes a C++ header with all of it as constexpr data plus typed setters.
+ * The Makefile runs it for each lesson program before compiling, so if a shader changes its attributes or drops a
+ * uniform the C++ side stops compiling instead of silently drawing garbage.
+ *
+ * Usage: ./reflect_shaders <StructName> <output.h> <vertex.vs> <fragment.fs> [DEFINE...]
+ *
+ * This isn't a real GLSL parser. It understands what our lessons use: #ifdef/#ifndef/#if defined()/#else/#endif,
+ * `layout (location = N) in type name;` and `uniform type name;` outside of uniform blocks.
+ */
+#include "shader_preprocessor.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cctype>
+#include <cstring>
+
+struct ReflectedAttribute
+{
+    std::string name;
+    std::string type;
+    int location;
+    int components;
+};
+
+struct ReflectedUniform
+{
+    std::string name;
+    std::string type;
+    int arraySize; // 0 if not an array
+};
+
+bool reflectFailed = false;
+
+std::string trim(const std::string &text)
+{
+    std::size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+    {
+        return "";
+    }
+    std::size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+bool hasDefine(const std::vector<std::string> &defines, const std::string &name)
+{
+    for (const std::string &define : defines)
+    {
+        // "LIGHTS 4" defines LIGHTS
+        if (define == name || define.compare(0, name.size() + 1, name + " ") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Drops lines hidden by #ifdef & friends, plus comments. The preprocessed source has our defines at the top
+ * already, and #define lines further down get picked up as we go.
+ */
+std::string evaluateConditionals(const std::string &source, const char* path)
+{
+    std::vector<std::string> defines;
+    std::vector<bool> active; // One per open #if, true if that branch is being kept
+    std::vector<bool> taken;  // Whether any branch of that #if was kept yet
+    std::stringstream in(source);
+    std::string line, out;
+    bool inComment = false;
+
+    while (std::getline(in, line))
+    {
+        // Strip comments first so a commented out #ifdef doesn't count
+        std::string code;
+        for (std::size_t i = 0; i < line.size(); i++)
+        {
+            if (inComment)
+            {
+                if (line.compare(i, 2, "*/") == 0)
+                {
+                    inComment = false;
+                    i++;
+                }
+                continue;
+            }
+            if (line.compare(i, 2, "//") == 0)
+            {
+                break;
+            }
+            if (line.compare(i, 2, "/*") == 0)
+            {
+                inComment = true;
+                i++;
+                continue;
+            }
+            code += line[i];
+        }
+
+        bool keeping = true;
+        for (bool branch : active)
+        {
+            keeping = keeping && branch;
+        }
+
+        std::string rest;
+        if (isShaderDirective(code, "ifdef", rest) || isShaderDirective(code, "ifndef", rest))
+        {
+            bool wanted = hasDefine(defines, trim(rest));
+            bool branch = isShaderDirective(code, "ifdef", rest) ? wanted : !wanted;
+            active.push_back(branch);
+            taken.push_back(branch);
+        }
+        else if (isShaderDirective(code, "if", rest))
+        {
+            rest = trim(rest);
+            bool branch = true;
+            if (rest.compare(0, 8, "defined(") == 0 && rest.back() == ')')
+            {
+                branch = hasDefine(defines, trim(rest.substr(8, rest.size() - 9)));
+            }
+            else
+            {
+                std::cout << "WARNING::REFLECT::UNSUPPORTED_IF, assuming true: " << path << ": " << code << std::endl;
+            }
+            active.push_back(branch);
+            taken.push_back(branch);
+        }
+        else if (isShaderDirective(code, "else", rest))
+        {
+            if (active.empty())
+            {
+                std::cout << "ERROR::REFLECT::ELSE_WITHOUT_IF " << path << std::endl;
+                reflectFailed = true;
+                continue;
+            }
+            active.back() = !taken.back();
+            taken.back() = true;
+        }
+        else if (isShaderDirective(code, "endif", rest))
+        {
+            if (active.empty())
+            {
+                std::cout << "ERROR::REFLECT::ENDIF_WITHOUT_IF " << path << std::endl;
+                reflectFailed = true;
+                continue;
+            }
+            active.pop_back();
+            taken.pop_back();
+        }
+        else if (keeping && isShaderDirective(code, "define", rest))
+        {
+            defines.push_back(trim(rest));
+        }
+        else if (keeping && trim(code).compare(0, 1, "#") != 0)
+        {
+            out += code + "\n";
+        }
+    }
+    return out;
+}
+
+int componentsOf(const std::string &type)
+{
+    if (type == "float" || type == "int" || type == "uint" || type == "bool")
+    {
+        return 1;
+    }
+    if (type.size() == 4 && type.compare(0, 3, "vec") == 0)
+    {
+        return type[3] - '0';
+    }
+    if (type.size() == 5 && (type.compare(0, 4, "ivec") == 0 || type.compare(0, 4, "uvec") == 0))
+    {
+        return type[4] - '0';
+    }
+    return 0;
+}
+
+std::string glTypeOf(const std::string &type)
+{
+    if (type[0] == 'i')
+    {
+        return "GL_INT";
+    }
+    if (type[0] == 'u')
+    {
+        return "GL_UNSIGNED_INT";
+    }
+    return "GL_FLOAT";
+}
+
+std::vector<std::string> splitWords(const std::string &statement)
+{
+    // Treat the punctuation in `layout (location = 0)` as separators too
+    std::string spaced;
+    for (char c : statement)
+    {
+        spaced += (c == '(' || c == ')' || c == '=' || c == ',') ? ' ' : c;
+    }
+    std::vector<std::string> words;
+    std::stringstream in(spaced);
+    std::string word;
+    while (in >> word)
+    {
+        words.push_back(word);
+    }
+    return words;
+}
+
+void reflectShader(const std::string &code, bool isVertex, std::vector<ReflectedAttribute> &attributes, std::vector<ReflectedUniform> &uniforms)
+{
+    int blockDepth = 0;
+    std::size_t start = 0;
+    while (start < code.size())
+    {
+        std::size_t end = code.find_first_of(";{}", start);
+        if (end == std::string::npos)
+        {
+            break;
+        }
+        std::string statement = trim(code.substr(start, end - start));
+        char terminator = code[end];
+        start = end + 1;
+
+        if (terminator == '{')
+        {
+            // Function bodies & uniform blocks. Nothing inside them is a plain uniform or attribute.
+            blockDepth++;
+            continue;
+        }
+        if (terminator == '}')
+        {
+            blockDepth--;
+            continue;
+        }
+        if (blockDepth > 0)
+        {
+            continue;
+        }
+
+        // Drop initializers: uniform float x = 1.0;
+        std::size_t equals = statement.find('=');
+        bool hasLayout = statement.compare(0, 6, "layout") == 0;
+        if (!hasLayout && equals != std::string::npos)
+        {
+            statement = trim(statement.substr(0, equals));
+        }
+        std::vector<std::string> words = splitWords(statement);
+        if (words.size() < 3)
+        {
+            continue;
+        }
+
+        if (words[0] == "uniform")
+        {
+            ReflectedUniform uniform{words[2], words[1], 0};
+            std::size_t bracket = uniform.name.find('[');
+            if (bracket != std::string::npos)
+            {
+                uniform.arraySize = std::atoi(uniform.name.c_str() + bracket + 1);
+                uniform.name = uniform.name.substr(0, bracket);
+            }
+            bool seen = false;
+            for (const ReflectedUniform &other : uniforms)
+            {
+                if (other.name == uniform.name)
+                {
+                    seen = true;
+                    if (other.type != uniform.type)
+                    {
+                        std::cout << "ERROR::REFLECT::UNIFORM_TYPE_MISMATCH " << uniform.name << " is " << other.type << " & " << uniform.type << std::endl;
+                        reflectFailed = true;
+                    }
+                }
+            }
+            if (!seen)
+            {
+                uniforms.push_back(uniform);
+            }
+        }
+        else if (isVertex && hasLayout && words.size() >= 6 && words[1] == "location" && words[3] == "in")
+        {
+            ReflectedAttribute attribute{words[5], words[4], std::atoi(words[2].c_str()), componentsOf(words[4])};
+            attributes.push_back(attribute);
+        }
+        else if (isVertex && words[0] == "in")
+        {
+            std::cout << "ERROR::REFLECT::ATTRIBUTE_WITHOUT_LOCATION " << words[2] << ", add layout (location = N)" << std::endl;
+            reflectFailed = true;
+        }
+    }
+}
+
+std::string capitalize(const std::string &name)
+{
+    std::string out = name;
+    out[0] = (char)std::toupper((unsigned char)out[0]);
+    return out;
+}
+
+bool isSampler(const std::string &type)
+{
+    return type.find("sampler") != std::string::npos;
+}
+
+// The C++ type Shader::set<T> takes for a GLSL type (see UniformUpload in shader.h), or "" if there isn't one.
+std::string cppTypeOf(const std::string &type)
+{
+    static const char* const types[][2] = {
+        {"float", "float"}, {"int", "int"}, {"bool", "int"},
+        {"vec2", "Vec2"}, {"vec3", "Vec3"}, {"vec4", "Vec4"}, {"mat3", "Mat3"}, {"mat4", "Mat4"},
+    };
+    for (const auto &pair : types)
+    {
+        if (type == pair[0])
+        {
+            return pair[1];
+        }
+    }
+    return "";
+}
+
+// The GLenum glGetActiveUniform reports for a GLSL type, as the name of the constant, or "" if we don't know it.
+std::string uniformGLTypeOf(const std::string &type)
+{
+    static const char* const types[][2] = {
+        {"float", "GL_FLOAT"}, {"vec2", "GL_FLOAT_VEC2"}, {"vec3", "GL_FLOAT_VEC3"}, {"vec4", "GL_FLOAT_VEC4"},
+        {"int", "GL_INT"}, {"ivec2", "GL_INT_VEC2"}, {"ivec3", "GL_INT_VEC3"}, {"ivec4", "GL_INT_VEC4"},
+        {"uint", "GL_UNSIGNED_INT"}, {"uvec2", "GL_UNSIGNED_INT_VEC2"}, {"uvec3", "GL_UNSIGNED_INT_VEC3"}, {"uvec4", "GL_UNSIGNED_INT_VEC4"},
+        {"bool", "GL_BOOL"}, {"bvec2", "GL_BOOL_VEC2"}, {"bvec3", "GL_BOOL_VEC3"}, {"bvec4", "GL_BOOL_VEC4"},
+        {"mat2", "GL_FLOAT_MAT2"}, {"mat3", "GL_FLOAT_MAT3"}, {"mat4", "GL_FLOAT_MAT4"},
+        {"mat2x3", "GL_FLOAT_MAT2x3"}, {"mat2x4", "GL_FLOAT_MAT2x4"}, {"mat3x2", "GL_FLOAT_MAT3x2"},
+        {"mat3x4", "GL_FLOAT_MAT3x4"}, {"mat4x2", "GL_FLOAT_MAT4x2"}, {"mat4x3", "GL_FLOAT_MAT4x3"},
+    };
+    for (const auto &pair : types)
+    {
+        if (type == pair[0])
+        {
+            return pair[1];
+        }
+    }
+    if (!isSampler(type))
+    {
+        return "";
+    }
+    // Samplers are built up from pieces: isampler2DArray => GL_INT_SAMPLER_2D_ARRAY
+    static const char* const pieces[][2] = {
+        {"1D", "1D"}, {"2D", "2D"}, {"3D", "3D"}, {"Cube", "CUBE"}, {"Rect", "RECT"}, {"Buffer", "BUFFER"},
+        {"MS", "MULTISAMPLE"}, {"Array", "ARRAY"}, {"Shadow", "SHADOW"},
+    };
+    std::size_t at = type.find("sampler");
+    std::string prefix = type.substr(0, at);
+    std::string glType = prefix == "i" ? "GL_INT_SAMPLER" : prefix == "u" ? "GL_UNSIGNED_INT_SAMPLER" : prefix.empty() ? "GL_SAMPLER" : "";
+    at += std::strlen("sampler");
+    while (!glType.empty() && at < type.size())
+    {
+        bool matched = false;
+        for (const auto &piece : pieces)
+        {
+            if (type.compare(at, std::strlen(piece[0]), piece[0]) == 0)
+            {
+                glType += std::string("_") + piece[1];
+                at += std::strlen(piece[0]);
+                matched = true;
+                break;
+            }
+        }
+        if (!matched)
+        {
+            return "";
+        }
+    }
+    return glType;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 5)
+    {
+        std::cout << "Usage: " << argv[0] << " <StructName> <output.h> <vertex.vs> <fragment.fs> [DEFINE...]" << std::endl;
+        return 1;
+    }
+    std::string structName = argv[1];
+    std::string outputPath = argv[2];
+    const char* vertexPath = argv[3];
+    const char* fragmentPath = argv[4];
+    std::vector<std::string> defines(argv + 5, argv + argc);
+
+    std::vector<ReflectedAttribute> attributes;
+    std::vector<ReflectedUniform> uniforms;
+    const char* paths[] = {vertexPath, fragmentPath};
+    for (int i = 0; i < 2; i++)
+    {
+        const char* source = shaderSources.load(paths[i]);
+        if (source == NULL)
+        {
+            return 1;
+        }
+        std::string code = evaluateConditionals(preprocessShader(source, paths[i], defines), paths[i]);
+        shaderSources.release();
+        reflectShader(code, i == 0, attributes, uniforms);
+    }
+    if (reflectFailed)
+    {
+        return 1;
+    }
+
+    std::stringstream out;
+    out << "// Generated by reflect_shaders from " << vertexPath << " & " << fragmentPath;
+    for (const std::string &define : defines)
+    {
+        out << " " << define;
+    }
+    out << ". Don't edit, the Makefile regenerates it.\n";
+    std::string guard = structName;
+    for (char &c : guard)
+    {
+        c = (char)std::toupper((unsigned char)c);
+    }
+    out << "#ifndef " << guard << "_H\n#define " << guard << "_H\n\n#include \"shader.h\"\n\n";
+    out << "#ifndef SHADER_ATTRIBUTE_DEFINED\n#define SHADER_ATTRIBUTE_DEFINED\n"
+        << "struct ShaderAttribute\n{\n    int location;\n    int components;\n    GLenum type;\n    int offset; // In components, from the start of the vertex, assuming attributes are interleaved in location order\n};\n#endif\n\n";
+
+    out << "struct " << structName << "\n{\n";
+    out << "    // Vertex attributes\n";
+    int offset = 0, lastLocation = -1;
+    for (int pass = 0; pass < (int)attributes.size(); pass++)
+    {
+        // Location order, since that's how the lessons lay out their vertices[]
+        const ReflectedAttribute* next = NULL;
+        for (const ReflectedAttribute &attribute : attributes)
+        {
+            if (attribute.location > lastLocation && (next == NULL || attribute.location < next->location))
+            {
+                next = &attribute;
+            }
+        }
+        out << "    static constexpr ShaderAttribute " << next->name << "{" << next->location << ", " << next->components
+            << ", " << glTypeOf(next->type) << ", " << offset << "};\n";
+        offset += next->components;
+        lastLocation = next->location;
+    }
+    out << "    static constexpr int attributeCount = " << attributes.size() << ";\n";
+    out << "    static constexpr int componentsPerVertex = " << offset << ";\n\n";
+
+    out << "    // Uniforms, already hashed for the Shader setters\n";
+    int unit = 0;
+    for (const ReflectedUniform &uniform : uniforms)
+    {
+        // The type too, so callers can static_assert they're sending the right thing
+        std::string glType = uniformGLTypeOf(uniform.type);
+        out << "    static constexpr UniformName " << uniform.name << " = \"" << uniform.name << "\"_u;\n";
+        out << "    static constexpr GLenum " << uniform.name << "Type = " << (glType.empty() ? "GL_NONE" : glType) << "; // " << uniform.type;
+        if (uniform.arraySize > 0)
+        {
+            out << "[" << uniform.arraySize << "]";
+        }
+        out << "\n";
+        if (isSampler(uniform.type))
+        {
+            out << "    static constexpr int " << uniform.name << "Unit = " << unit++ << ";\n";
+        }
+    }
+    out << "\n";
+
+    out << "    // Texture units are handed out in declaration order. Call once after creating the Shader.\n";
+    bool anySamplers = false;
+    for (const ReflectedUniform &uniform : uniforms)
+    {
+        anySamplers = anySamplers || isSampler(uniform.type);
+    }
+    // Unnamed when there's nothing to bind, or -Wunused-parameter complains about every lesson without textures
+    out << "    static void bindSamplers(const Shader &" << (anySamplers ? "shader" : "") << ")\n    {\n";
+    for (const ReflectedUniform &uniform : uniforms)
+    {
+        if (isSampler(uniform.type))
+        {
+            out << "        shader.setInt(" << uniform.name << ", " << uniform.name << "Unit);\n";
+        }
+    }
+    out << "    }\n";
+
+    for (const ReflectedUniform &uniform : uniforms)
+    {
+        std::string cppType = cppTypeOf(uniform.type);
+        if (isSampler(uniform.type) || cppType.empty())
+        {
+            continue;
+        }
+        std::string name = capitalize(uniform.name);
+        if (uniform.arraySize > 0)
+        {
+            // Whole array in one glUniform*v call. Sending fewer than arraySize is fine, the rest keep their values.
+            out << "    static constexpr int " << uniform.name << "Count = " << uniform.arraySize << ";\n";
+            out << "    static void set" << name << "(const Shader &shader, const " << cppType << "* values, int count = " << uniform.arraySize
+                << ") { shader.set(" << uniform.name << ", values, count); }\n";
+        }
+        else if (uniform.type == "bool")
+        {
+            out << "    static void set" << name << "(const Shader &shader, bool value) { shader.setBool(" << uniform.name << ", value); }\n";
+        }
+        else
+        {
+            std::string parameter = cppType == "float" || cppType == "int" ? cppType + " value" : "const " + cppType + " &value";
+            out << "    static void set" << name << "(const Shader &shader, " << parameter << ") { shader.set(" << uniform.name << ", value); }\n";
+        }
+    }
+    out << "};\n\n#endif\n";
+
+    std::string generated = out.str();
+    std::ofstream file(outputPath);
+    file << generated;
+    if (!file)
+    {
+        std::cout << "ERROR::REFLECT::CANNOT_WRITE " << outputPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
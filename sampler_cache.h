@@ -0,0 +1,132 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * -- Sampler Objects --
+ * glTexParameteri puts the filtering & wrapping on the texture itself, so the same image can't be sampled two ways,
+ * and changing how it's filtered is a handful of calls on whatever texture is bound (if one is bound at all!).
+ * GL 3.3 sampler objects hold that state separately. Bound to a texture unit, they override the texture's own
+ * settings for whatever texture is on that unit.
+ *
+ * The cache makes one sampler per distinct set of parameters (hashed, so asking again is a map lookup) and remembers
+ * what's bound on each unit, so switching filtering modes is one glBindSampler, or nothing if it's already there.
+ *
+ * Usage:
+ *     SamplerCache samplers;
+ *     SamplerParams pixelated;
+ *     pixelated.minFilter = GL_NEAREST_MIPMAP_LINEAR;
+ *     pixelated.magFilter = GL_NEAREST;
+ *     ...every frame...
+ *     samplers.bind(0, pixelated); // Whatever texture is on unit 0 now samples like this
+ */
+struct SamplerParams
+{
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    GLenum wrapS = GL_REPEAT;
+    GLenum wrapT = GL_REPEAT;
+    GLenum wrapR = GL_REPEAT;
+    float borderColor[4] = {0.0f, 0.0f, 0.0f, 0.0f}; // Only for GL_CLAMP_TO_BORDER
+    float lodBias = 0.0f;
+
+    bool operator==(const SamplerParams &other) const
+    {
+        return minFilter == other.minFilter && magFilter == other.magFilter && wrapS == other.wrapS && wrapT == other.wrapT && wrapR == other.wrapR
+            && std::memcmp(borderColor, other.borderColor, sizeof(borderColor)) == 0 && lodBias == other.lodBias;
+    }
+};
+
+// FNV-1a over each field (not the whole struct, the padding between them could be anything)
+struct SamplerParamsHash
+{
+    std::size_t operator()(const SamplerParams &params) const
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash](const void* data, std::size_t size)
+        {
+            for (std::size_t i = 0; i < size; i++)
+            {
+                hash = (hash ^ ((const unsigned char*)data)[i]) * 1099511628211ull;
+            }
+        };
+        add(&params.minFilter, sizeof(params.minFilter));
+        add(&params.magFilter, sizeof(params.magFilter));
+        add(&params.wrapS, sizeof(params.wrapS));
+        add(&params.wrapT, sizeof(params.wrapT));
+        add(&params.wrapR, sizeof(params.wrapR));
+        add(params.borderColor, sizeof(params.borderColor));
+        add(&params.lodBias, sizeof(params.lodBias));
+        return (std::size_t)hash;
+    }
+};
+
+class SamplerCache
+{
+public:
+    // The sampler object for these parameters, made the first time they're asked for.
+    unsigned int get(const SamplerParams &params);
+
+    // glBindSampler on `unit`, skipped if that sampler is already bound there.
+    void bind(int unit, const SamplerParams &params);
+
+    // Back to the texture's own glTexParameteri settings on `unit`.
+    void unbind(int unit);
+
+    std::size_t size() const { return samplers.size(); }
+
+private:
+    std::unordered_map<SamplerParams, unsigned int, SamplerParamsHash> samplers;
+    std::vector<unsigned int> bound; // Per texture unit, 0 = none
+};
+
+inline unsigned int SamplerCache::get(const SamplerParams &params)
+{
+    auto found = samplers.find(params);
+    if (found != samplers.end())
+    {
+        return found->second;
+    }
+    unsigned int sampler;
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, params.minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, params.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, params.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, params.wrapT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, params.wrapR);
+    glSamplerParameterfv(sampler, GL_TEXTURE_BORDER_COLOR, params.borderColor);
+    glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, params.lodBias);
+    samplers[params] = sampler;
+    return sampler;
+}
+
+inline void SamplerCache::bind(int unit, const SamplerParams &params)
+{
+    unsigned int sampler = get(params);
+    if (unit >= (int)bound.size())
+    {
+        bound.resize(unit + 1, 0);
+    }
+    if (bound[unit] != sampler)
+    {
+        glBindSampler(unit, sampler);
+        bound[unit] = sampler;
+    }
+}
+
+inline void SamplerCache::unbind(int unit)
+{
+    if (unit < (int)bound.size() && bound[unit] != 0)
+    {
+        glBindSampler(unit, 0);
+        bound[unit] = 0;
+    }
+}
+
+#endif
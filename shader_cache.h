@@ -0,0 +1,206 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "gl_extensions.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <sys/stat.h>
+
+/**
+ * -- Program Binary Cache --
+ * Compiling & linking GLSL is the slowest thing our lessons do at startup, and it's the exact same work every launch.
+ * With GL_ARB_get_program_binary the driver can hand us the linked program as a blob, which we save under
+ * ~/.cache/learning-opengl/ and feed back with glProgramBinary next time.
+ *
+ * The key hashes both sources plus GL_RENDERER & GL_VERSION, since a blob is only valid for the driver that made it.
+ * Even then the driver is allowed to reject it (e.g. after an update), so callers must fall back to compiling.
+ * Set LEARNOPENGL_NO_SHADER_CACHE=1 to always compile, which is handy for timing a cold start.
+ */
+
+// File layout: magic, key, binary format, binary length, then the binary itself.
+const char SHADER_CACHE_MAGIC[8] = {'L', 'O', 'G', 'L', 'P', 'B', '1', '\0'};
+
+inline std::uint64_t hashShaderBytes(std::uint64_t hash, const char* data, std::size_t length)
+{
+    for (std::size_t i = 0; i < length; i++)
+    {
+        hash ^= (std::uint8_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline std::uint64_t hashShaderString(std::uint64_t hash, const char* text)
+{
+    if (text == NULL)
+    {
+        text = "";
+    }
+    // Hash the terminator too, so "ab" + "c" doesn't collide with "a" + "bc"
+    return hashShaderBytes(hash, text, std::strlen(text) + 1);
+}
+
+inline bool shaderCacheEnabled()
+{
+    const char* disabled = std::getenv("LEARNOPENGL_NO_SHADER_CACHE");
+    return GLExt.programBinary && (disabled == NULL || disabled[0] == '\0' || disabled[0] == '0');
+}
+
+inline std::uint64_t shaderCacheKey(const char* vertexCode, const char* fragmentCode)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    hash = hashShaderString(hash, vertexCode);
+    hash = hashShaderString(hash, fragmentCode);
+    hash = hashShaderString(hash, (const char*)glGetString(GL_RENDERER));
+    hash = hashShaderString(hash, (const char*)glGetString(GL_VERSION));
+    return hash;
+}
+
+// $XDG_CACHE_HOME/learning-opengl, or ~/.cache/learning-opengl. Empty if neither can be worked out.
+inline std::string shaderCacheDirectory()
+{
+    std::string base;
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    if (xdg != NULL && xdg[0] != '\0')
+    {
+        base = xdg;
+    }
+    else if (home != NULL && home[0] != '\0')
+    {
+        base = std::string(home) + "/.cache";
+    }
+    else
+    {
+        return "";
+    }
+    return base + "/learning-opengl";
+}
+
+inline std::string shaderCachePath(std::uint64_t key)
+{
+    std::string directory = shaderCacheDirectory();
+    if (directory.empty())
+    {
+        return "";
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+    return directory + name;
+}
+
+/**
+ * Tries to give `program` its linked binary from disk. Returns true only if the driver accepted it & the
+ * program reports GL_LINK_STATUS. A rejected blob gets deleted so we don't keep retrying it.
+ */
+inline bool loadCachedProgram(unsigned int program, std::uint64_t key)
+{
+    std::string path = shaderCachePath(key);
+    if (!shaderCacheEnabled() || path.empty())
+    {
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    char magic[8];
+    std::uint64_t storedKey = 0;
+    std::uint32_t format = 0, length = 0;
+    file.read(magic, sizeof(magic));
+    file.read((char*)&storedKey, sizeof(storedKey));
+    file.read((char*)&format, sizeof(format));
+    file.read((char*)&length, sizeof(length));
+    if (!file || std::memcmp(magic, SHADER_CACHE_MAGIC, sizeof(magic)) != 0 || storedKey != key || length == 0)
+    {
+        std::remove(path.c_str());
+        return false;
+    }
+
+    std::vector<char> binary(length);
+    file.read(binary.data(), length);
+    if (!file)
+    {
+        std::remove(path.c_str());
+        return false;
+    }
+
+    GLExt.ProgramBinary(program, (GLenum)format, binary.data(), (GLsizei)length);
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        std::cout << "SHADER::CACHE::BINARY_REJECTED, recompiling " << path << std::endl;
+        std::remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Call before glLinkProgram, otherwise some drivers won't keep the binary around for us to grab.
+inline void markProgramCacheable(unsigned int program)
+{
+    if (shaderCacheEnabled())
+    {
+        GLExt.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+/**
+ * Saves a freshly linked program. Writes to a .tmp file first & renames it, so a crash mid-write (or two lessons
+ * running at once) never leaves a half written blob behind.
+ */
+inline void saveCachedProgram(unsigned int program, std::uint64_t key)
+{
+    std::string path = shaderCachePath(key);
+    if (!shaderCacheEnabled() || path.empty())
+    {
+        return;
+    }
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    GLExt.GetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+    {
+        return;
+    }
+
+    // mkdir fails harmlessly if the directory is already there
+    std::string directory = shaderCacheDirectory();
+    mkdir(directory.substr(0, directory.rfind('/')).c_str(), 0755);
+    mkdir(directory.c_str(), 0755);
+
+    std::string temporary = path + ".tmp";
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    std::uint32_t storedFormat = format, storedLength = (std::uint32_t)written;
+    file.write(SHADER_CACHE_MAGIC, sizeof(SHADER_CACHE_MAGIC));
+    file.write((const char*)&key, sizeof(key));
+    file.write((const char*)&storedFormat, sizeof(storedFormat));
+    file.write((const char*)&storedLength, sizeof(storedLength));
+    file.write(binary.data(), written);
+    file.close();
+    if (!file || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        std::cout << "SHADER::CACHE::WRITE_FAILED " << path << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,34 @@
+# version 330 core
+// One vertex shader for every lesson so far, the differences are switched on with defines from C++.
+// OFFSET => shifts the vertex along x by the `offset` uniform & passes the position on (exerciseAll.cpp)
+// TEXCOORD => passes texture coordinates on (textures.cpp)
+// PULSE => the vertex colors pulse over time, from the uniform buffer every lesson shares (frame_uniforms.glsl)
+#include "vertex_inputs.glsl"
+#include "frame_uniforms.glsl"
+
+out vec3 color;
+#ifdef OFFSET
+uniform float offset;
+out vec4 position;
+#endif
+#ifdef TEXCOORD
+out vec2 texCoord;
+#endif
+
+void main()
+{
+#ifdef OFFSET
+    vec3 offset_vector = vec3(offset, 0.0, 0.0);
+    position = vec4(aPos + offset_vector, 1.0);
+    gl_Position = position;
+#else
+    gl_Position = vec4(aPos, 1.0);
+#endif
+    color = aColor;
+#ifdef PULSE
+    color *= 0.75 + 0.25 * sin(time);
+#endif
+#ifdef TEXCOORD
+    texCoord = aTexCoord;
+#endif
+}
@@ -1,6 +1,10 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "shader.h"
+#include "shader_library.h"
+#include "../frame_uniforms.h"
+#include "offset_bindings.h" // Generated from the shaders by the Makefile, see reflect_shaders.cpp
+#include "../shader_watcher.h"
 
 
 #include <iostream>
@@ -38,13 +42,19 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // Anything past GL 3.3 that glad doesn't load for us (program binaries, etc). See gl_extensions.h
+    loadGLExtensions((GLADloadproc) glfwGetProcAddress);
 
     glViewport(0, 0, 800, 600);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
 
     // Using the Shader we created! Handles all the compiling, linking, etc.
-    Shader shaderProgram = Shader("shader_lesson/shader1.vs", "shader_lesson/shader1.fs");
+    // basic.vs is shared by every lesson, OFFSET switches on the part with the offset uniform.
+    // Through the library, so the driver compiles it while we set up the vertex data instead of us waiting on it.
+    ShaderLibrary library;
+    library.add("offset", "shader_lesson/basic.vs", "shader_lesson/shader1.fs", {"OFFSET"});
+    library.submit();
 
     unsigned int VBO;
     glGenBuffers(1, &VBO);
@@ -58,19 +68,61 @@ int main()
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     // Vertex Attribute for Positions & Colors respectively
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-
-    glEnableVertexAttribArray(0); 
-    glEnableVertexAttribArray(1);
+    // Locations & sizes come from the shader itself. If the shader's inputs stop matching vertices[] this won't compile.
+    static_assert(OffsetBindings::componentsPerVertex == 6, "vertices[] has 6 floats per vertex");
+    const int stride = OffsetBindings::componentsPerVertex * sizeof(float);
+    glVertexAttribPointer(OffsetBindings::aPos.location, OffsetBindings::aPos.components, GL_FLOAT, GL_FALSE, stride, (void*)(OffsetBindings::aPos.offset * sizeof(float)));
+    glVertexAttribPointer(OffsetBindings::aColor.location, OffsetBindings::aColor.components, GL_FLOAT, GL_FALSE, stride, (void*)(OffsetBindings::aColor.offset * sizeof(float)));
+
+    glEnableVertexAttribArray(OffsetBindings::aPos.location); 
+    glEnableVertexAttribArray(OffsetBindings::aColor.location);
     
+    // First use reads the compile/link status (see shader_library.h)
+    Shader &shaderProgram = library.get("offset");
     shaderProgram.use();
-    int offsetLocation = glGetUniformLocation(shaderProgram.ID, "offset");
-    glUniform1f(offsetLocation, 0.0f);
+    // Location was already grabbed when the shader linked, and the name was hashed at compile time.
+    OffsetBindings::setOffset(shaderProgram, 0.0f);
+
+    // Per-frame data for every program, one upload a frame (see frame_uniforms.h)
+    UniformBuffer<FrameUniforms> frameUniforms(FRAME_UNIFORMS_BINDING, 3);
+    shaderProgram.bindUniformBlock(frameUniforms);
+    FrameUniforms frameData;
+
+    // Edit shader_lesson/shader1.fs (or basic.vs, or vertex_inputs.glsl it includes) while this is running & it gets swapped in without restarting. See shader_watcher.h
+    ShaderWatcher watcher;
+    int watchID = watcher.watch("shader_lesson/basic.vs", "shader_lesson/shader1.fs", shaderProgram.includes());
+    std::string newVertexCode, newFragmentCode;
+    std::vector<ShaderFile> newIncludedFiles;
+    // Frame times so we can see whether a reload causes a hitch. averageFrame is a running average.
+    double lastFrame = glfwGetTime(), averageFrame = 0.0;
+    bool reloadedLastFrame = false;
+    unsigned int frameCount = 0;
 
     while (!glfwWindowShouldClose(window)) 
     {
+        double now = glfwGetTime();
+        double frameTime = now - lastFrame;
+        lastFrame = now;
+        if (reloadedLastFrame)
+        {
+            std::cout << "SHADER::RELOAD frame took " << frameTime * 1000.0 << "ms (average " << averageFrame * 1000.0 << "ms)" << std::endl;
+            reloadedLastFrame = false;
+        }
+        else
+        {
+            averageFrame = averageFrame == 0.0 ? frameTime : averageFrame * 0.95 + frameTime * 0.05;
+        }
+
+        // Between frames is the only safe spot to swap programs
+        if (watcher.takeChanged(watchID, newVertexCode, newFragmentCode, newIncludedFiles))
+        {
+            shaderProgram.reload(newVertexCode, newFragmentCode, &newIncludedFiles);
+            reloadedLastFrame = true;
+        }
+
         processInput(window);
+        frameData.time = (float)glfwGetTime();
+        frameUniforms.update(frameData);
 
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -84,11 +136,20 @@ int main()
         //glUniform4f(ourColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
 
         shaderProgram.use();
+        // Same value every frame, so after the first one it never reaches the driver (see uniformStats)
+        OffsetBindings::setOffset(shaderProgram, 0.0f);
         glBindVertexArray(VAO); 
         glDrawArrays(GL_TRIANGLES, 0, 3); 
         
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // How many glUniform calls the shadow copies saved, every 600 frames (10 seconds at 60fps)
+        uniformStats.endFrame();
+        if (++frameCount % 600 == 0)
+        {
+            uniformStats.print();
+        }
     }
 
     glfwTerminate();
@@ -0,0 +1,6 @@
+// Per-frame data every program reads from one uniform buffer. Has to match FRAME_UNIFORMS in frame_uniforms.h,
+// Shader::bindUniformBlock checks the offsets when a program gets hooked up to it.
+layout (std140) uniform FrameUniforms
+{
+    float time; // Seconds since the window opened
+};
@@ -4,9 +4,158 @@
 #include <glad/glad.h>
 
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+
+#include "../shader_cache.h"
+#include "../shader_source.h"
+#include "../shader_preprocessor.h"
+#include "../uniform_buffer.h"
+
+/**
+ * FNV-1a hash of a uniform name. It's constexpr so that `"offset"_u` below is hashed by the compiler,
+ * meaning the setters never have to touch a string at runtime.
+ */
+constexpr std::uint32_t hashUniformName(const char* name, std::size_t length)
+{
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < length; i++)
+    {
+        hash ^= (std::uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// A uniform name that has already been hashed. Make them with the _u literal: shader.setFloat("offset"_u, 1.0f);
+struct UniformName
+{
+    std::uint32_t hash;
+};
+
+constexpr UniformName operator""_u(const char* name, std::size_t length)
+{
+    return UniformName{hashUniformName(name, length)};
+}
+
+/**
+ * A uniform looked up once (see Shader::getUniform). It remembers the row in the uniform table plus the name hash,
+ * so it keeps working after a hot reload moves things around. index -1 => the uniform doesn't exist & setters do nothing.
+ * element is the array element setters start at, for handles looked up as "name[N]".
+ */
+struct UniformHandle
+{
+    std::uint32_t hash = 0;
+    int index = -1;
+    int element = 0;
+};
+
+/**
+ * glUniform calls that actually went to the driver vs. ones skipped because the value was already set.
+ * Shared by every Shader. Call endFrame() once per frame, then lastUploads/lastElided hold that frame's numbers
+ * (the lessons print() them every few seconds).
+ */
+struct UniformStats
+{
+    unsigned int uploads = 0;
+    unsigned int elided = 0;
+    unsigned int lastUploads = 0;
+    unsigned int lastElided = 0;
+
+    void endFrame()
+    {
+        lastUploads = uploads;
+        lastElided = elided;
+        uploads = elided = 0;
+    }
+
+    void print() const
+    {
+        std::cout << "SHADER::UNIFORMS last frame " << lastUploads << " uploads, " << lastElided << " elided" << std::endl;
+    }
+};
+
+inline UniformStats uniformStats;
+
+// One row of the uniform table that gets built right after linking.
+struct UniformInfo
+{
+    std::string name; // Arrays are stored without the "[0]" GL reports
+    std::uint32_t hash;
+    int location;
+    GLenum type;
+    int size; // Number of array elements, 1 if not an array
+    int shadowOffset; // Where this uniform's last value lives in Shader's shadow copy
+    int shadowBytes;
+    int firstElement; // Where its elements start in Shader::shadowKnown
+};
+
+/**
+ * Plain structs for vector & matrix uniforms, laid out exactly the way glUniform*v wants them.
+ * Matrices are column-major like GLSL, so m[4 * column + row] for a Mat4.
+ */
+struct Vec2 { float x, y; };
+struct Vec3 { float x, y, z; };
+struct Vec4 { float x, y, z, w; };
+struct Mat3 { float m[9]; };
+struct Mat4 { float m[16]; };
+
+static_assert(sizeof(Vec3) == 3 * sizeof(float) && sizeof(Mat4) == 16 * sizeof(float), "uniform types must be tightly packed");
+
+/**
+ * How each C++ type gets to GL, picked at compile time by Shader::set<T>. Every one of them is a single glUniform*v
+ * call no matter how many elements are sent. Want another type (say glm::vec3)? Add a specialization here.
+ */
+template <typename T>
+struct UniformUpload;
+
+template <> struct UniformUpload<float> { static constexpr GLenum type = GL_FLOAT;      static void upload(int location, int count, const float* values) { glUniform1fv(location, count, values); } };
+template <> struct UniformUpload<int>   { static constexpr GLenum type = GL_INT;        static void upload(int location, int count, const int* values)   { glUniform1iv(location, count, values); } };
+template <> struct UniformUpload<Vec2>  { static constexpr GLenum type = GL_FLOAT_VEC2; static void upload(int location, int count, const Vec2* values)  { glUniform2fv(location, count, &values->x); } };
+template <> struct UniformUpload<Vec3>  { static constexpr GLenum type = GL_FLOAT_VEC3; static void upload(int location, int count, const Vec3* values)  { glUniform3fv(location, count, &values->x); } };
+template <> struct UniformUpload<Vec4>  { static constexpr GLenum type = GL_FLOAT_VEC4; static void upload(int location, int count, const Vec4* values)  { glUniform4fv(location, count, &values->x); } };
+template <> struct UniformUpload<Mat3>  { static constexpr GLenum type = GL_FLOAT_MAT3; static void upload(int location, int count, const Mat3* values)  { glUniformMatrix3fv(location, count, GL_FALSE, values->m); } };
+template <> struct UniformUpload<Mat4>  { static constexpr GLenum type = GL_FLOAT_MAT4; static void upload(int location, int count, const Mat4* values)  { glUniformMatrix4fv(location, count, GL_FALSE, values->m); } };
+
+// Ints also go to bools & samplers, the same way setInt does.
+inline bool uniformTypeAccepts(GLenum uniformType, GLenum uploadType)
+{
+    if (uniformType == uploadType)
+    {
+        return true;
+    }
+    if (uploadType != GL_INT)
+    {
+        return false;
+    }
+    switch (uniformType)
+    {
+    case GL_BOOL: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_ARRAY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Bytes one element of a uniform of this type takes in the shadow copy. Bools & samplers are set as ints.
+inline int uniformTypeBytes(GLenum type)
+{
+    switch (type)
+    {
+    case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2: return 8;
+    case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3: return 12;
+    case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2: return 16;
+    case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: return 24;
+    case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: return 32;
+    case GL_FLOAT_MAT3: return 36;
+    case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: return 48;
+    case GL_FLOAT_MAT4: return 64;
+    default: return 4;
+    }
+}
 
 class Shader 
 {
@@ -14,66 +163,165 @@ public:
     // Program ID
     unsigned int ID;
 
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // Every active uniform in the program, filled in once after glLinkProgram succeeds.
+    std::vector<UniformInfo> uniforms;
+
+    // `defines` get #define'd at the top of both shaders, see shader_preprocessor.h (which also handles #include).
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines = std::vector<std::string>());
+    // Empty shader with no program yet. ShaderLibrary fills these in once their program is finished.
+    Shader();
 
     // Activate shader
     void use();
 
-    // Utility Functions for setting Uniform values
+    /**
+     * Swap in a new program built from these (unprocessed) sources, only if it links. Returns false & keeps the old one otherwise.
+     * Their #includes come from `includedFiles` if given (ShaderWatcher reads them), otherwise they're read here.
+     */
+    bool reload(const std::string &newVertexCode, const std::string &newFragmentCode, const std::vector<ShaderFile>* includedFiles = NULL);
+
+    // Every file either shader #includes, as of the last build. Hand them to ShaderWatcher so editing one reloads us too.
+    const std::vector<std::string> &includes() const { return includePaths; }
+
+    // Look up a uniform location once, outside the render loop, and keep the handle around.
+    UniformHandle getUniform(const std::string &name) const;
+    UniformHandle getUniform(UniformName name) const;
+
+    /**
+     * Utility Functions for setting Uniform values. Like glUniform*, every setter writes to the bound program, so call
+     * use() first. The shadow copy can't tell which program the value went to, so a set on an unbound Shader would
+     * also stop the real one from ever being sent. Debug builds (no NDEBUG) check & skip it with an error instead.
+     */
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
 
+    // Hot path versions. No driver lookup & no std::string allocation.
+    void setBool(UniformHandle uniform, bool value) const;
+    void setInt(UniformHandle uniform, int value) const;
+    void setFloat(UniformHandle uniform, float value) const;
+    void setBool(UniformName name, bool value) const;
+    void setInt(UniformName name, int value) const;
+    void setFloat(UniformName name, float value) const;
+
+    /**
+     * Any type with a UniformUpload specialization: shader.set(handle, Vec3{1, 0, 0}) or shader.set("model"_u, matrix).
+     * The pointer + count versions send a whole array (e.g. a matrix palette) in one call.
+     */
+    template <typename T>
+    void set(UniformHandle uniform, const T &value) const;
+    template <typename T>
+    void set(UniformHandle uniform, const T* values, int count) const;
+    template <typename T>
+    void set(UniformName name, const T &value) const;
+    template <typename T>
+    void set(UniformName name, const T* values, int count) const;
+    template <typename T>
+    void set(UniformHandle uniform, const std::vector<T> &values) const;
+
+    // Hook this program's std140 block up to a shared UniformBuffer (see uniform_buffer.h). Once per program, not per frame.
+    template <typename T>
+    bool bindUniformBlock(const UniformBuffer<T> &buffer) const
+    {
+        return ::bindUniformBlock<T>(ID, buffer.binding);
+    }
+
+private:
+    friend class ShaderLibrary;
+
+    // Kept so reload() can run the new sources through the preprocessor the same way
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> defines;
+    std::vector<std::string> includePaths;
+
+    /**
+     * Open addressing hash table over `uniforms`. Each slot holds an index into `uniforms` or -1 if empty.
+     * Size is always a power of two so we can mask the hash instead of using %.
+     */
+    std::vector<int> uniformSlots;
+
+    /**
+     * CPU copy of the last value sent for every uniform, so setting the same value twice doesn't reach the driver.
+     * shadowKnown has a flag per array element (one for plain uniforms), 0 until that element is set the first time
+     * (GLSL initializers mean we can't assume it starts at 0).
+     * Mutable since the setters are const, the shadow is just a cache of what GL already has.
+     */
+    mutable std::vector<unsigned char> shadow;
+    mutable std::vector<unsigned char> shadowKnown;
+
+    int resolveUniform(UniformHandle uniform) const;
+    int uploadLocation(UniformHandle uniform, const void* value, std::size_t bytes) const;
+
+    static unsigned int compileProgram(const char* vShaderCode, const char* fShaderCode, bool &linked);
+    void buildUniformTable();
+    void copyUniformValues(unsigned int from, const std::vector<UniformInfo> &fromUniforms);
+    void copyUniformBlockBindings(unsigned int from);
+    int findUniform(std::uint32_t hash, const char* name) const;
 };
 
 /**
  * Reads vertex/fragment shaders from its file & compiles them.
  * Lots of cool stuff I've learned!
  */
-Shader::Shader(const char* vertexPath, const char* fragmentPath) 
+inline Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines)
 {
-    // 1. Retrieve source code from files
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    // Set what exceptions to flag
-    vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit); // Note syntax. | => OR Operation!
-    fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit); // Also you don't need the space between func and (). But C++ docs does this.
+    /**
+     * 1. Retrieve source code from files. One read() per file into a pooled buffer (or no I/O at all when the
+     * shaders are embedded), see shader_source.h. A missing file just prints an error & compiles as empty.
+     * Then expand #includes & add the defines.
+     */
+    const char* vertexFile = shaderSources.load(vertexPath);
+    const char* fragmentFile = shaderSources.load(fragmentPath);
+    std::string vertexCode = preprocessShader(vertexFile == NULL ? "" : vertexFile, vertexPath, defines, &includePaths);
+    std::string fragmentCode = preprocessShader(fragmentFile == NULL ? "" : fragmentFile, fragmentPath, defines, &includePaths);
+    // We have our own copies now, so the buffers can go back to the pool
+    shaderSources.release();
 
-    try 
-    {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-
-        /**
-         * StringStream's to grab the string data from the files.
-         * Ifstreams use rdbuf() which gives access to the internal buf file. 
-         * And stringstreams use the in operator (<<) to grab stuff when it has access to a buf file. 
-         * Check c++ documentation for more information. 
-         */
-        std::stringstream vertexStream, fragmentStream;
-        vertexStream << vShaderFile.rdbuf();
-        fragmentStream << fShaderFile.rdbuf();
-
-        // Now that we have the data, close the files.
-        vShaderFile.close();
-        fShaderFile.close();
+    // Recall that our source shaders were of type char and not string.
+    const char* vShaderCode = vertexCode.c_str();
+    const char* fShaderCode = fragmentCode.c_str();
 
-        // Remember that stringstreams are not the type string. It's a stream.
-        vertexCode = vertexStream.str();
-        fragmentCode = fragmentStream.str();
-    } 
-    catch (std::ifstream::failure e) 
+    /**
+     * Try the on-disk binary cache before compiling anything (see shader_cache.h).
+     * Both paths are timed so we can see what a warm start actually saves us.
+     */
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t cacheKey = shaderCacheKey(vShaderCode, fShaderCode);
+    ID = glCreateProgram();
+    bool warmStart = loadCachedProgram(ID, cacheKey);
+    if (warmStart)
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_READ_SUCCESSFULLY" << std::endl;
+        buildUniformTable();
     }
+    else
+    {
+        // A rejected binary can leave the program in a weird state, so start from a clean one.
+        glDeleteProgram(ID);
+        bool linked;
+        ID = compileProgram(vShaderCode, fShaderCode, linked);
+        if (linked)
+        {
+            buildUniformTable();
+            saveCachedProgram(ID, cacheKey);
+        }
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "SHADER::PROGRAM::" << (warmStart ? "WARM_START " : "COLD_START ") << milliseconds << "ms ("
+              << vertexPath << ", " << fragmentPath << ")" << std::endl;
+}
 
-    // Recall that our source shaders were of type char and not string.
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
+inline Shader::Shader() : ID(0)
+{
+}
 
-    // Compiling time! Process is the exact same from hello_triangle.cpp
+/**
+ * Compiling time! Process is the exact same from hello_triangle.cpp
+ * Returns the new program even if linking failed (check `linked`), the caller decides what to do with it.
+ */
+inline unsigned int Shader::compileProgram(const char* vShaderCode, const char* fShaderCode, bool &linked)
+{
     unsigned int vertex, fragment;
     int success;
     char infoLog[512];
@@ -99,40 +347,434 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     }
 
     // Create Shader Program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    markProgramCacheable(program);
+    glLinkProgram(program);
 
-    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success)
     {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
     }
+    linked = success != 0;
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    return program;
+}
+
+/**
+ * Hot reload (see shader_watcher.h). Builds a brand new program from the given sources and only swaps it into ID
+ * if it links. A typo in the shader file just prints the error & we keep drawing with the old program.
+ * Call it between frames, on the thread that owns the GL context.
+ */
+inline bool Shader::reload(const std::string &newVertexCode, const std::string &newFragmentCode, const std::vector<ShaderFile>* includedFiles)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> newIncludes;
+    std::string vertexCode = preprocessShader(newVertexCode.c_str(), vertexPath.c_str(), defines, &newIncludes, includedFiles);
+    std::string fragmentCode = preprocessShader(newFragmentCode.c_str(), fragmentPath.c_str(), defines, &newIncludes, includedFiles);
+    shaderSources.release();
+
+    bool linked;
+    unsigned int program = compileProgram(vertexCode.c_str(), fragmentCode.c_str(), linked);
+    if (!linked)
+    {
+        glDeleteProgram(program);
+        std::cout << "ERROR::SHADER::RELOAD_FAILED, keeping the old program" << std::endl;
+        return false;
+    }
+
+    // A new program starts with every uniform at 0, so carry over whatever was set on the old one (sampler units etc).
+    unsigned int old = ID;
+    std::vector<UniformInfo> oldUniforms;
+    oldUniforms.swap(uniforms);
+    ID = program;
+    buildUniformTable();
+    copyUniformValues(old, oldUniforms);
+    copyUniformBlockBindings(old);
+    glDeleteProgram(old);
+    includePaths.swap(newIncludes);
+    saveCachedProgram(ID, shaderCacheKey(vertexCode.c_str(), fragmentCode.c_str()));
+
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "SHADER::RELOAD " << milliseconds << "ms" << std::endl;
+    return true;
+}
+
+/**
+ * Which binding point a uniform block reads from is part of the program too (see bindUniformBlock), so point the
+ * new program's blocks wherever the old program's blocks of the same name were.
+ */
+inline void Shader::copyUniformBlockBindings(unsigned int from)
+{
+    int blocks = 0;
+    glGetProgramiv(from, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+    for (int i = 0; i < blocks; i++)
+    {
+        char name[256];
+        glGetActiveUniformBlockName(from, i, sizeof(name), NULL, name);
+        int binding = 0;
+        glGetActiveUniformBlockiv(from, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+        unsigned int index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(ID, index, binding);
+        }
+    }
 }
 
-void Shader::use()
+/**
+ * Reads back each uniform of the old program with glGetUniform & sets it on the new one, if it has a uniform of the
+ * same name & type. GL 3.3 has no glProgramUniform so the new program gets bound while we do it,
+ * and whatever was bound before is restored (the new program if the old one was bound).
+ */
+inline void Shader::copyUniformValues(unsigned int from, const std::vector<UniformInfo> &fromUniforms)
 {
+    int current = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &current);
     glUseProgram(ID);
+
+    for (const UniformInfo &oldInfo : fromUniforms)
+    {
+        int index = findUniform(oldInfo.hash, oldInfo.name.c_str());
+        if (index == -1 || uniforms[index].type != oldInfo.type)
+        {
+            continue;
+        }
+        const UniformInfo &newInfo = uniforms[index];
+        int count = newInfo.size < oldInfo.size ? newInfo.size : oldInfo.size;
+        for (int element = 0; element < count; element++)
+        {
+            // Array elements aren't guaranteed to have consecutive locations, so ask for each one by name.
+            int oldLocation = oldInfo.location, newLocation = newInfo.location;
+            if (element > 0)
+            {
+                std::string elementName = oldInfo.name + "[" + std::to_string(element) + "]";
+                oldLocation = glGetUniformLocation(from, elementName.c_str());
+                newLocation = glGetUniformLocation(ID, elementName.c_str());
+            }
+
+            float floats[16];
+            int ints[4];
+            switch (newInfo.type)
+            {
+            case GL_FLOAT:      glGetUniformfv(from, oldLocation, floats); glUniform1fv(newLocation, 1, floats); break;
+            case GL_FLOAT_VEC2: glGetUniformfv(from, oldLocation, floats); glUniform2fv(newLocation, 1, floats); break;
+            case GL_FLOAT_VEC3: glGetUniformfv(from, oldLocation, floats); glUniform3fv(newLocation, 1, floats); break;
+            case GL_FLOAT_VEC4: glGetUniformfv(from, oldLocation, floats); glUniform4fv(newLocation, 1, floats); break;
+            case GL_FLOAT_MAT3: glGetUniformfv(from, oldLocation, floats); glUniformMatrix3fv(newLocation, 1, GL_FALSE, floats); break;
+            case GL_FLOAT_MAT4: glGetUniformfv(from, oldLocation, floats); glUniformMatrix4fv(newLocation, 1, GL_FALSE, floats); break;
+            case GL_INT_VEC2:   glGetUniformiv(from, oldLocation, ints); glUniform2iv(newLocation, 1, ints); break;
+            case GL_INT_VEC3:   glGetUniformiv(from, oldLocation, ints); glUniform3iv(newLocation, 1, ints); break;
+            case GL_INT_VEC4:   glGetUniformiv(from, oldLocation, ints); glUniform4iv(newLocation, 1, ints); break;
+            // Bools & samplers are set with glUniform1i too
+            case GL_INT:
+            case GL_BOOL:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_3D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_2D_ARRAY:
+                glGetUniformiv(from, oldLocation, ints); glUniform1i(newLocation, ints[0]); break;
+            default:
+                break;
+            }
+        }
+    }
+
+    glUseProgram((unsigned int)current == from ? ID : (unsigned int)current);
+}
+
+/**
+ * Asks GL for every active uniform exactly once. After this glGetUniformLocation never has to be called again,
+ * which matters since it's a string lookup inside the driver every single time.
+ */
+inline void Shader::buildUniformTable()
+{
+    int count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    uniforms.clear();
+    uniforms.reserve(count);
+    int shadowBytes = 0, elements = 0;
+    std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+    for (int i = 0; i < count; i++)
+    {
+        int length = 0, size = 0;
+        GLenum type;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+        // Uniforms living inside a uniform block don't have a location. Skip them.
+        int location = glGetUniformLocation(ID, nameBuffer.data());
+        if (location == -1)
+        {
+            continue;
+        }
+
+        std::string name(nameBuffer.data(), length);
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            name.resize(name.size() - 3);
+        }
+        std::uint32_t hash = hashUniformName(name.c_str(), name.size());
+        int bytes = uniformTypeBytes(type) * size;
+        uniforms.push_back(UniformInfo{name, hash, location, type, size, shadowBytes, bytes, elements});
+        shadowBytes += bytes;
+        elements += size;
+    }
+    shadow.assign(shadowBytes, 0);
+    shadowKnown.assign(elements, 0);
+
+    // Keep the table at most half full so probes stay short.
+    std::size_t slotCount = 8;
+    while (slotCount < uniforms.size() * 2)
+    {
+        slotCount *= 2;
+    }
+    uniformSlots.assign(slotCount, -1);
+    for (int i = 0; i < (int)uniforms.size(); i++)
+    {
+        std::size_t slot = uniforms[i].hash & (slotCount - 1);
+        while (uniformSlots[slot] != -1)
+        {
+            // The _u setters only compare hashes, so two names with the same hash would be a silent bug.
+            if (uniforms[uniformSlots[slot]].hash == uniforms[i].hash)
+            {
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION\n" << uniforms[uniformSlots[slot]].name << " & " << uniforms[i].name << std::endl;
+            }
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        uniformSlots[slot] = i;
+    }
+}
+
+/**
+ * Returns the index into `uniforms` or -1. Pass name as NULL to match on the hash alone (what the _u literal does).
+ */
+inline int Shader::findUniform(std::uint32_t hash, const char* name) const
+{
+    if (uniformSlots.empty())
+    {
+        return -1;
+    }
+    std::size_t mask = uniformSlots.size() - 1;
+    for (std::size_t slot = hash & mask; uniformSlots[slot] != -1; slot = (slot + 1) & mask)
+    {
+        const UniformInfo &info = uniforms[uniformSlots[slot]];
+        if (info.hash == hash && (name == NULL || info.name == name))
+        {
+            return uniformSlots[slot];
+        }
+    }
+    return -1;
+}
+
+inline UniformHandle Shader::getUniform(const std::string &name) const
+{
+    int index = findUniform(hashUniformName(name.c_str(), name.size()), name.c_str());
+    if (index != -1)
+    {
+        return UniformHandle{uniforms[index].hash, index};
+    }
+
+    // "lights[2]": the table only has "lights", so find that & start at element 2. Its elements have consecutive locations.
+    std::size_t open = name.rfind('[');
+    if (open == std::string::npos || open == 0 || name.back() != ']' || open + 2 == name.size() || name.size() - open > 11)
+    {
+        return UniformHandle{};
+    }
+    int element = 0;
+    for (std::size_t i = open + 1; i + 1 < name.size(); i++)
+    {
+        if (name[i] < '0' || name[i] > '9')
+        {
+            return UniformHandle{};
+        }
+        element = element * 10 + (name[i] - '0');
+    }
+    index = findUniform(hashUniformName(name.c_str(), open), name.substr(0, open).c_str());
+    if (index == -1 || element >= uniforms[index].size)
+    {
+        return UniformHandle{};
+    }
+    return UniformHandle{uniforms[index].hash, index, element};
+}
+
+inline UniformHandle Shader::getUniform(UniformName name) const
+{
+    return UniformHandle{name.hash, findUniform(name.hash, NULL)};
+}
+
+/**
+ * Index into `uniforms` for a handle. Normally just the stored index, but if a reload shuffled the table
+ * we find it again by hash.
+ */
+inline int Shader::resolveUniform(UniformHandle uniform) const
+{
+    if (uniform.index == -1)
+    {
+        return -1;
+    }
+    int index = uniform.index;
+    if (index >= (int)uniforms.size() || uniforms[index].hash != uniform.hash)
+    {
+        index = findUniform(uniform.hash, NULL);
+    }
+    // The array might have shrunk in a reload
+    return index != -1 && uniform.element < uniforms[index].size ? index : -1;
 }
 
-void Shader::setBool(const std::string &name, bool value) const
+/**
+ * The dirty check every setter goes through. Compares against the shadow copy & returns the location to upload to,
+ * or -1 if there's nothing to do: either the uniform doesn't exist or it already has this exact value.
+ */
+inline int Shader::uploadLocation(UniformHandle uniform, const void* value, std::size_t bytes) const
+{
+    int index = resolveUniform(uniform);
+    if (index == -1)
+    {
+        return -1;
+    }
+#ifndef NDEBUG
+    int current = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+    if ((unsigned int)current != ID)
+    {
+        std::cout << "ERROR::SHADER::PROGRAM_NOT_BOUND setting " << uniforms[index].name << ", call use() first" << std::endl;
+        return -1;
+    }
+#endif
+    const UniformInfo &info = uniforms[index];
+    int elementBytes = info.shadowBytes / info.size;
+    int offset = uniform.element * elementBytes;
+    if (bytes > (std::size_t)(info.shadowBytes - offset))
+    {
+        bytes = info.shadowBytes - offset;
+    }
+    // Only skip it if every element being written is known to hold this value already
+    unsigned char* last = shadow.data() + info.shadowOffset + offset;
+    unsigned char* known = shadowKnown.data() + info.firstElement + uniform.element;
+    std::size_t count = (bytes + elementBytes - 1) / elementBytes;
+    if (std::memchr(known, 0, count) == NULL && std::memcmp(last, value, bytes) == 0)
+    {
+        uniformStats.elided++;
+        return -1;
+    }
+    std::memcpy(last, value, bytes);
+    std::memset(known, 1, count);
+    uniformStats.uploads++;
+    return info.location + uniform.element;
+}
+
+inline void Shader::use()
+{
+    glUseProgram(ID);
+}
+
+inline void Shader::setBool(const std::string &name, bool value) const
+{
+    setBool(getUniform(name), value);
+}
+
+inline void Shader::setInt(const std::string &name, int value) const
+{
+    setInt(getUniform(name), value);
+}
+
+inline void Shader::setFloat(const std::string &name, float value) const
+{
+    setFloat(getUniform(name), value);
+}
+
+inline void Shader::setBool(UniformHandle uniform, bool value) const
 {
     // Recall that the shaders are basically in C. So no strings or boolean types => cast.
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    setInt(uniform, (int)value);
+}
+
+inline void Shader::setInt(UniformHandle uniform, int value) const
+{
+    int location = uploadLocation(uniform, &value, sizeof(value));
+    if (location != -1)
+    {
+        glUniform1i(location, value);
+    }
+}
+
+inline void Shader::setFloat(UniformHandle uniform, float value) const
+{
+    int location = uploadLocation(uniform, &value, sizeof(value));
+    if (location != -1)
+    {
+        glUniform1f(location, value);
+    }
+}
+
+inline void Shader::setBool(UniformName name, bool value) const
+{
+    setBool(getUniform(name), value);
+}
+
+inline void Shader::setInt(UniformName name, int value) const
+{
+    setInt(getUniform(name), value);
+}
+
+inline void Shader::setFloat(UniformName name, float value) const
+{
+    setFloat(getUniform(name), value);
+}
+
+template <typename T>
+void Shader::set(UniformHandle uniform, const T* values, int count) const
+{
+    int index = resolveUniform(uniform);
+    if (index == -1 || count <= 0)
+    {
+        return;
+    }
+    if (!uniformTypeAccepts(uniforms[index].type, UniformUpload<T>::type))
+    {
+        std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << uniforms[index].name << std::endl;
+        return;
+    }
+    // GL ignores anything past the end of the uniform array, so don't count it in the dirty check either
+    if (count > uniforms[index].size - uniform.element)
+    {
+        count = uniforms[index].size - uniform.element;
+    }
+    int location = uploadLocation(uniform, values, sizeof(T) * count);
+    if (location != -1)
+    {
+        UniformUpload<T>::upload(location, count, values);
+    }
+}
+
+template <typename T>
+void Shader::set(UniformHandle uniform, const T &value) const
+{
+    set(uniform, &value, 1);
+}
+
+template <typename T>
+void Shader::set(UniformName name, const T &value) const
+{
+    set(getUniform(name), &value, 1);
 }
 
-void Shader::setInt(const std::string &name, int value) const
+template <typename T>
+void Shader::set(UniformName name, const T* values, int count) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    set(getUniform(name), values, count);
 }
 
-void Shader::setFloat(const std::string &name, float value) const
+template <typename T>
+void Shader::set(UniformHandle uniform, const std::vector<T> &values) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    set(uniform, values.data(), (int)values.size());
 }
 #endif 
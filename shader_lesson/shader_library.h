@@ -0,0 +1,246 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include "shader.h"
+
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include <iostream>
+
+/**
+ * -- Shader Library --
+ * Shader's constructor compiles & then immediately asks glGetShaderiv for the result, so the driver has to finish
+ * that program before we can even start on the next one. With a lot of programs that adds up fast.
+ *
+ * Instead: add() everything, submit() once, which fires off every compile and then every link without asking for
+ * any status. Status is only read the first time a program is actually needed (get/use). If the driver has
+ * GL_KHR_parallel_shader_compile it compiles on its own threads in the meantime, and isReady() can poll
+ * GL_COMPLETION_STATUS_KHR without blocking. Without it, things still work but get() may block like before.
+ *
+ * Usage:
+ *     ShaderLibrary library;
+ *     library.add("triangle", "shader_lesson/basic.vs", "shader_lesson/shader.fs");
+ *     library.add("offset", "shader_lesson/basic.vs", "shader_lesson/shader1.fs", {"OFFSET"});
+ *     library.submit();
+ *     ...
+ *     Shader &offset = library.get("offset"); // First use reads the compile/link status
+ *     offset.use();
+ */
+class ShaderLibrary
+{
+public:
+    ShaderLibrary();
+
+    // Queue a program. Nothing touches GL until submit().
+    void add(const std::string &name, const char* vertexPath, const char* fragmentPath,
+             const std::vector<std::string> &defines = std::vector<std::string>());
+
+    // Kick off every queued compile, then every link. Never reads a status, so it never waits on the driver.
+    void submit();
+
+    // True once the program can be used without blocking. Always true after submit() if the driver can't tell us.
+    bool isReady(const std::string &name) const;
+
+    // Finish the program if needed (may block) and hand it back. Returns an empty Shader for unknown names.
+    Shader& get(const std::string &name);
+    void use(const std::string &name);
+
+private:
+    struct Entry
+    {
+        std::string vertexPath;
+        std::string fragmentPath;
+        unsigned int vertex = 0;
+        unsigned int fragment = 0;
+        std::uint64_t cacheKey = 0;
+        bool submitted = false;
+        bool fromCache = false;
+        bool finished = false;
+        Shader shader;
+    };
+
+    // unordered_map never moves its elements, so references from get() stay valid when more programs are added.
+    std::unordered_map<std::string, Entry> entries;
+    Shader missing;
+
+    void finish(Entry &entry);
+};
+
+inline ShaderLibrary::ShaderLibrary()
+{
+    // 0xFFFFFFFF => let the driver pick however many threads it wants.
+    if (GLExt.parallelShaderCompile)
+    {
+        GLExt.MaxShaderCompilerThreads(0xFFFFFFFFu);
+    }
+}
+
+inline void ShaderLibrary::add(const std::string &name, const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines)
+{
+    Entry &entry = entries[name];
+    entry.vertexPath = vertexPath;
+    entry.fragmentPath = fragmentPath;
+    entry.shader.vertexPath = vertexPath;
+    entry.shader.fragmentPath = fragmentPath;
+    entry.shader.defines = defines;
+}
+
+inline void ShaderLibrary::submit()
+{
+    auto start = std::chrono::steady_clock::now();
+    int count = 0;
+
+    // 1. Read everything & start every compile. Programs found in the binary cache skip compiling altogether.
+    for (auto &pair : entries)
+    {
+        Entry &entry = pair.second;
+        if (entry.submitted)
+        {
+            continue;
+        }
+        const char* vertexFile = shaderSources.load(entry.vertexPath.c_str());
+        const char* fragmentFile = shaderSources.load(entry.fragmentPath.c_str());
+        std::string vertexCode = preprocessShader(vertexFile == NULL ? "" : vertexFile, entry.vertexPath.c_str(), entry.shader.defines, &entry.shader.includePaths);
+        std::string fragmentCode = preprocessShader(fragmentFile == NULL ? "" : fragmentFile, entry.fragmentPath.c_str(), entry.shader.defines, &entry.shader.includePaths);
+        shaderSources.release();
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+        entry.cacheKey = shaderCacheKey(vShaderCode, fShaderCode);
+        entry.shader.ID = glCreateProgram();
+        if (loadCachedProgram(entry.shader.ID, entry.cacheKey))
+        {
+            entry.fromCache = true;
+        }
+        else
+        {
+            glDeleteProgram(entry.shader.ID);
+            entry.shader.ID = glCreateProgram();
+
+            entry.vertex = glCreateShader(GL_VERTEX_SHADER);
+            entry.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(entry.vertex, 1, &vShaderCode, NULL);
+            glShaderSource(entry.fragment, 1, &fShaderCode, NULL);
+            glCompileShader(entry.vertex);
+            glCompileShader(entry.fragment);
+        }
+        count++;
+    }
+
+    // 2. Start every link. Linking before checking the compile status is fine, a failed compile just fails the link.
+    for (auto &pair : entries)
+    {
+        Entry &entry = pair.second;
+        if (entry.submitted)
+        {
+            continue;
+        }
+        if (!entry.fromCache)
+        {
+            glAttachShader(entry.shader.ID, entry.vertex);
+            glAttachShader(entry.shader.ID, entry.fragment);
+            markProgramCacheable(entry.shader.ID);
+            glLinkProgram(entry.shader.ID);
+        }
+        entry.submitted = true;
+    }
+
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "SHADER::LIBRARY::SUBMITTED " << count << " programs in " << milliseconds << "ms"
+              << (GLExt.parallelShaderCompile ? " (parallel compile)" : "") << std::endl;
+}
+
+inline bool ShaderLibrary::isReady(const std::string &name) const
+{
+    auto found = entries.find(name);
+    if (found == entries.end() || !found->second.submitted)
+    {
+        return false;
+    }
+    const Entry &entry = found->second;
+    if (entry.finished || entry.fromCache || !GLExt.parallelShaderCompile)
+    {
+        return true;
+    }
+    int done = 0;
+    glGetProgramiv(entry.shader.ID, GL_COMPLETION_STATUS_KHR, &done);
+    return done != 0;
+}
+
+inline Shader& ShaderLibrary::get(const std::string &name)
+{
+    auto found = entries.find(name);
+    if (found == entries.end())
+    {
+        std::cout << "ERROR::SHADER::LIBRARY::UNKNOWN_PROGRAM " << name << std::endl;
+        return missing;
+    }
+    Entry &entry = found->second;
+    if (!entry.submitted)
+    {
+        submit();
+    }
+    if (!entry.finished)
+    {
+        finish(entry);
+    }
+    return entry.shader;
+}
+
+inline void ShaderLibrary::use(const std::string &name)
+{
+    get(name).use();
+}
+
+/**
+ * This is where we finally read the statuses. Same error messages as Shader's constructor.
+ */
+inline void ShaderLibrary::finish(Entry &entry)
+{
+    int success;
+    char infoLog[512];
+
+    if (!entry.fromCache)
+    {
+        glGetShaderiv(entry.vertex, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(entry.vertex, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED " << entry.vertexPath << "\n" << infoLog << std::endl;
+        }
+        glGetShaderiv(entry.fragment, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(entry.fragment, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED " << entry.fragmentPath << "\n" << infoLog << std::endl;
+        }
+
+        glGetProgramiv(entry.shader.ID, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(entry.shader.ID, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        }
+        else
+        {
+            saveCachedProgram(entry.shader.ID, entry.cacheKey);
+        }
+
+        glDeleteShader(entry.vertex);
+        glDeleteShader(entry.fragment);
+        entry.vertex = entry.fragment = 0;
+    }
+    else
+    {
+        success = 1;
+    }
+
+    if (success)
+    {
+        entry.shader.buildUniformTable();
+    }
+
+    entry.finished = true;
+}
+
+#endif
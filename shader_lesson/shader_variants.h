@@ -0,0 +1,90 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "shader.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+/**
+ * -- Shader Permutations --
+ * One vertex/fragment pair with a list of optional defines, where each combination ("variant") is its own program.
+ * Bit i of the mask turns on defines[i]. A variant is only compiled the first time someone asks for it, and then
+ * it's cached, so asking for the same mask again just hands back the same program object.
+ *
+ * Usage:
+ *     ShaderVariants basic("shader_lesson/basic.vs", "shader_lesson/shader1.fs", {"OFFSET", "TEXCOORD"});
+ *     Shader &offsetOnly = basic.get(basic.bit("OFFSET"));
+ *     Shader &both = basic.get(basic.bit("OFFSET") | basic.bit("TEXCOORD"));
+ */
+class ShaderVariants
+{
+public:
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines);
+
+    // Mask bit for one of the defines, 0 if it isn't in the list.
+    std::uint32_t bit(const std::string &define) const;
+
+    // Compiles the variant the first time, afterwards it's just a lookup.
+    Shader& get(std::uint32_t mask);
+
+    // How many programs actually got built so far
+    int compiledCount() const;
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> defines;
+    // unordered_map keeps references to its elements valid, so get() can hand out Shader&'s
+    std::unordered_map<std::uint32_t, Shader> variants;
+};
+
+inline ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines)
+{
+    if (defines.size() > 32)
+    {
+        std::cout << "ERROR::SHADER::VARIANTS::TOO_MANY_DEFINES only the first 32 can be used" << std::endl;
+        this->defines.resize(32);
+    }
+}
+
+inline std::uint32_t ShaderVariants::bit(const std::string &define) const
+{
+    for (std::size_t i = 0; i < defines.size(); i++)
+    {
+        if (defines[i] == define)
+        {
+            return 1u << i;
+        }
+    }
+    return 0;
+}
+
+inline Shader& ShaderVariants::get(std::uint32_t mask)
+{
+    auto found = variants.find(mask);
+    if (found != variants.end())
+    {
+        return found->second;
+    }
+
+    std::vector<std::string> enabled;
+    for (std::size_t i = 0; i < defines.size(); i++)
+    {
+        if (mask & (1u << i))
+        {
+            enabled.push_back(defines[i]);
+        }
+    }
+    return variants.emplace(mask, Shader(vertexPath.c_str(), fragmentPath.c_str(), enabled)).first->second;
+}
+
+inline int ShaderVariants::compiledCount() const
+{
+    return (int)variants.size();
+}
+
+#endif
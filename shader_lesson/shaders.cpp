@@ -1,6 +1,8 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "shader.h"
+#include "shader_library.h"
+#include "../frame_uniforms.h"
 
 
 #include <iostream>
@@ -38,13 +40,18 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // Anything past GL 3.3 that glad doesn't load for us (program binaries, etc). See gl_extensions.h
+    loadGLExtensions((GLADloadproc) glfwGetProcAddress);
 
     glViewport(0, 0, 800, 600);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
 
     // Using the Shader we created! Handles all the compiling, linking, etc.
-    Shader shaderProgram = Shader("shader_lesson/shader.vs", "shader_lesson/shader.fs");
+    // Through the library, so the driver compiles it while we set up the vertex data instead of us waiting on it.
+    ShaderLibrary library;
+    library.add("triangle", "shader_lesson/basic.vs", "shader_lesson/shader.fs");
+    library.submit();
 
     unsigned int VBO;
     glGenBuffers(1, &VBO);
@@ -66,9 +73,19 @@ int main()
     
 
 
+    // First use reads the compile/link status (see shader_library.h)
+    Shader &shaderProgram = library.get("triangle");
+
+    // Per-frame data for every program, one upload a frame (see frame_uniforms.h)
+    UniformBuffer<FrameUniforms> frameUniforms(FRAME_UNIFORMS_BINDING, 3);
+    shaderProgram.bindUniformBlock(frameUniforms);
+    FrameUniforms frameData;
+
     while (!glfwWindowShouldClose(window)) 
     {
         processInput(window);
+        frameData.time = (float)glfwGetTime();
+        frameUniforms.update(frameData);
 
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
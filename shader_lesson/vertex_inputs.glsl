@@ -0,0 +1,6 @@
+// Vertex attributes every lesson uses. Included by basic.vs, the locations match the glVertexAttribPointer calls.
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+#ifdef TEXCOORD
+layout (location = 2) in vec2 aTexCoord;
+#endif
@@ -0,0 +1,251 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include "shader_source.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+/**
+ * -- GLSL Preprocessor --
+ * GLSL has #define/#ifdef but no #include, and no way to pass defines in from C++. This adds both, before the
+ * source goes to glShaderSource:
+ *   - `#include "file.glsl"` pastes the file in, relative to the file doing the including. Each file is only
+ *     pasted once per shader, so there's no need for include guards.
+ *   - Every entry in `defines` becomes a #define right after the #version line (which GLSL insists is first).
+ *     "TEXCOORD" => #define TEXCOORD, "LIGHTS 4" => #define LIGHTS 4
+ *
+ * #line directives are added around includes so compile errors still point at the right line. GLSL's #line only
+ * takes numbers, so the second number is which file: 0 is the shader itself, 1+ are includes in the order found.
+ */
+
+const int SHADER_MAX_INCLUDE_DEPTH = 16;
+
+// A shader file read ahead of time. ShaderWatcher's thread reads a shader's includes this way, so a hot reload
+// doesn't read them on the render thread.
+struct ShaderFile
+{
+    std::string path;
+    std::string code;
+};
+
+struct ShaderPreprocessState
+{
+    std::vector<std::string> included; // Paths already pasted, also used for the #line file numbers
+    const std::vector<ShaderFile>* files = NULL; // Where includes come from if set, instead of reading them with shaderSources
+    bool failed = false;
+};
+
+inline std::string shaderDirectoryOf(const std::string &path)
+{
+    std::size_t slash = path.rfind('/');
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+// True if `line` is a preprocessor directive called `name`, allowing spaces like "# version 330". `rest` gets what follows.
+inline bool isShaderDirective(const std::string &line, const char* name, std::string &rest)
+{
+    std::size_t i = line.find_first_not_of(" \t");
+    if (i == std::string::npos || line[i] != '#')
+    {
+        return false;
+    }
+    i = line.find_first_not_of(" \t", i + 1);
+    std::size_t length = std::strlen(name);
+    if (i == std::string::npos || line.compare(i, length, name) != 0)
+    {
+        return false;
+    }
+    rest = line.substr(i + length);
+    return true;
+}
+
+// `rest` is what follows #include. Gives the path it names, relative to the file doing the including.
+inline bool shaderIncludePath(const std::string &rest, const std::string &path, std::string &includePath)
+{
+    std::size_t open = rest.find('"');
+    std::size_t close = open == std::string::npos ? std::string::npos : rest.find('"', open + 1);
+    if (close == std::string::npos)
+    {
+        return false;
+    }
+    includePath = shaderDirectoryOf(path) + rest.substr(open + 1, close - open - 1);
+    return true;
+}
+
+inline void expandShaderSource(const std::string &source, const std::string &path, int fileNumber, int depth,
+                        ShaderPreprocessState &state, std::string &out, const std::vector<std::string>* defines)
+{
+    std::size_t start = 0;
+    int lineNumber = 0;
+    while (start < source.size())
+    {
+        std::size_t end = source.find('\n', start);
+        if (end == std::string::npos)
+        {
+            end = source.size();
+        }
+        std::string line = source.substr(start, end - start);
+        start = end + 1;
+        lineNumber++;
+
+        std::string rest;
+        if (defines != NULL && isShaderDirective(line, "version", rest))
+        {
+            out += line + "\n";
+            for (const std::string &define : *defines)
+            {
+                out += "#define " + define + "\n";
+            }
+            out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileNumber) + "\n";
+            defines = NULL;
+            continue;
+        }
+
+        if (!isShaderDirective(line, "include", rest))
+        {
+            out += line + "\n";
+            continue;
+        }
+
+        std::string includePath;
+        if (!shaderIncludePath(rest, path, includePath))
+        {
+            std::cout << "ERROR::SHADER::PREPROCESSOR::BAD_INCLUDE " << path << ":" << lineNumber << std::endl;
+            state.failed = true;
+            continue;
+        }
+
+        bool alreadyIncluded = false;
+        for (const std::string &included : state.included)
+        {
+            alreadyIncluded = alreadyIncluded || included == includePath;
+        }
+        if (alreadyIncluded)
+        {
+            continue;
+        }
+        if (depth >= SHADER_MAX_INCLUDE_DEPTH)
+        {
+            std::cout << "ERROR::SHADER::PREPROCESSOR::INCLUDE_TOO_DEEP " << includePath << std::endl;
+            state.failed = true;
+            continue;
+        }
+
+        const char* included = NULL;
+        if (state.files == NULL)
+        {
+            included = shaderSources.load(includePath.c_str());
+        }
+        else
+        {
+            for (const ShaderFile &file : *state.files)
+            {
+                if (file.path == includePath)
+                {
+                    included = file.code.c_str();
+                }
+            }
+            if (included == NULL)
+            {
+                std::cout << "ERROR::SHADER::PREPROCESSOR::INCLUDE_NOT_READ " << includePath << std::endl;
+            }
+        }
+        if (included == NULL)
+        {
+            state.failed = true;
+            continue;
+        }
+        state.included.push_back(includePath);
+        int includeNumber = (int)state.included.size();
+        out += "#line 1 " + std::to_string(includeNumber) + "\n";
+        expandShaderSource(included, includePath, includeNumber, depth + 1, state, out, NULL);
+        out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileNumber) + "\n";
+    }
+}
+
+/**
+ * Returns the expanded source. `path` is only used to find includes relative to it & for error messages.
+ * Includes are read through shaderSources, so call this before the pool gets released. Unless `files` is given,
+ * then they're taken from there (see readShaderIncludes) & nothing is read at all.
+ * `includes` (optional) gets the path of every file that was pasted in added to it.
+ */
+inline std::string preprocessShader(const char* source, const char* path, const std::vector<std::string> &defines,
+                             std::vector<std::string>* includes = NULL, const std::vector<ShaderFile>* files = NULL)
+{
+    ShaderPreprocessState state;
+    state.files = files;
+    std::string out;
+    out.reserve(std::strlen(source) + 64 * defines.size());
+    expandShaderSource(source, path, 0, 0, state, out, &defines);
+    if (state.failed)
+    {
+        std::cout << "ERROR::SHADER::PREPROCESSOR::FAILED " << path << std::endl;
+    }
+    if (includes != NULL)
+    {
+        for (const std::string &included : state.included)
+        {
+            bool known = false;
+            for (const std::string &include : *includes)
+            {
+                known = known || include == included;
+            }
+            if (!known)
+            {
+                includes->push_back(included);
+            }
+        }
+    }
+    return out;
+}
+
+/**
+ * Reads every file `source` #includes, and everything those include, into `files` (skipping ones already there).
+ * Finds them the same way preprocessShader does, but it's only plain file reads (no shaderSources), so any thread
+ * can call it. Returns false if one of them couldn't be read.
+ */
+inline bool readShaderIncludes(const std::string &source, const std::string &path, std::vector<ShaderFile> &files)
+{
+    std::size_t start = 0;
+    while (start < source.size())
+    {
+        std::size_t end = source.find('\n', start);
+        if (end == std::string::npos)
+        {
+            end = source.size();
+        }
+        std::string line = source.substr(start, end - start);
+        start = end + 1;
+
+        std::string rest, includePath;
+        if (!isShaderDirective(line, "include", rest) || !shaderIncludePath(rest, path, includePath))
+        {
+            continue; // A broken #include gets reported when it's preprocessed
+        }
+        bool alreadyRead = false;
+        for (const ShaderFile &file : files)
+        {
+            alreadyRead = alreadyRead || file.path == includePath;
+        }
+        if (alreadyRead)
+        {
+            continue;
+        }
+        ShaderFile file{includePath, std::string()};
+        if (!readShaderFile(includePath.c_str(), file.code))
+        {
+            return false;
+        }
+        files.push_back(file);
+        // Its own includes are relative to it. `file` is our copy, so `files` growing doesn't move it from under us.
+        if (!readShaderIncludes(file.code, includePath, files))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef EMBED_SHADERS
+// Generated by `make embed` (embed_shaders.sh). Every .vs/.fs/.glsl in the repo as constexpr data.
+#include "embedded_shaders.h"
+#endif
+
+/**
+ * -- Shader Source Loading --
+ * The old way was ifstream -> stringstream -> string, so three buffers per file & an exception when it's missing.
+ * Now each file gets exactly one read() straight into a block from a reusable pool, NUL terminated so it can go
+ * right into glShaderSource. Blocks never move, so pointers stay good until release() hands them back to the pool.
+ *
+ * Build with -DEMBED_SHADERS (after `make embed`) and load() just returns a pointer into the embedded table instead,
+ * meaning no filesystem I/O for shaders at all.
+ */
+
+// Reads a whole file with one read() call into `out`. Returns false (no exceptions) if it can't.
+inline bool readShaderFile(const char* path, std::string &out)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    out.resize((std::size_t)info.st_size);
+    ssize_t got = out.empty() ? 0 : read(fd, &out[0], out.size());
+    close(fd);
+    if (got != (ssize_t)out.size())
+    {
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+#ifdef EMBED_SHADERS
+inline const EmbeddedShader* findEmbeddedShader(const char* path)
+{
+    for (const EmbeddedShader &shader : EMBEDDED_SHADERS)
+    {
+        if (std::strcmp(shader.path, path) == 0)
+        {
+            return &shader;
+        }
+    }
+    return NULL;
+}
+#endif
+
+class ShaderSourcePool
+{
+public:
+    /**
+     * Returns the file's contents, NUL terminated, or NULL (with an error printed) if it can't be read.
+     * `length` (optional) gets the size without the terminator.
+     */
+    const char* load(const char* path, std::size_t* length = NULL);
+
+    // Everything load() returned is invalid after this. The memory stays around for the next load.
+    void release();
+
+private:
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        std::size_t capacity;
+        bool used;
+    };
+    std::vector<Block> blocks;
+
+    char* take(std::size_t size);
+};
+
+inline char* ShaderSourcePool::take(std::size_t size)
+{
+    // Smallest free block that fits, so a big shader doesn't hog the block a small one could've used.
+    Block* best = NULL;
+    for (Block &block : blocks)
+    {
+        if (!block.used && block.capacity >= size && (best == NULL || block.capacity < best->capacity))
+        {
+            best = &block;
+        }
+    }
+    if (best == NULL)
+    {
+        std::size_t capacity = 4096;
+        while (capacity < size)
+        {
+            capacity *= 2;
+        }
+        blocks.push_back(Block{std::unique_ptr<char[]>(new char[capacity]), capacity, false});
+        best = &blocks.back();
+    }
+    best->used = true;
+    return best->data.get();
+}
+
+inline const char* ShaderSourcePool::load(const char* path, std::size_t* length)
+{
+#ifdef EMBED_SHADERS
+    const EmbeddedShader* embedded = findEmbeddedShader(path);
+    if (embedded != NULL)
+    {
+        if (length != NULL)
+        {
+            *length = embedded->length;
+        }
+        return embedded->code;
+    }
+#endif
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) != 0)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        std::cout << "ERROR::SHADER::FILE_NOT_READ_SUCCESSFULLY " << path << std::endl;
+        return NULL;
+    }
+
+    std::size_t size = (std::size_t)info.st_size;
+    char* buffer = take(size + 1);
+    ssize_t got = size == 0 ? 0 : read(fd, buffer, size);
+    close(fd);
+    if (got != (ssize_t)size)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_READ_SUCCESSFULLY " << path << std::endl;
+        return NULL;
+    }
+    buffer[size] = '\0';
+    if (length != NULL)
+    {
+        *length = size;
+    }
+    return buffer;
+}
+
+inline void ShaderSourcePool::release()
+{
+    for (Block &block : blocks)
+    {
+        block.used = false;
+    }
+}
+
+// Shared by every Shader & ShaderLibrary. Render thread only, it isn't thread safe.
+inline ShaderSourcePool shaderSources;
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "shader_source.h"
+#include "shader_preprocessor.h" // readShaderIncludes
+
+/**
+ * -- Shader Hot Reload --
+ * A background thread that watches shader files with inotify (Linux only) and reads them as soon as they change,
+ * so the render thread never touches the disk. GL calls can only happen on the thread that owns the context though,
+ * so the compile & link still happens there: between frames, ask takeChanged() and hand the sources to Shader::reload().
+ *
+ * Files the shaders #include are watched too (Shader::includes() says which ones at the start). Editing one reloads
+ * every pair that uses it, and whenever a pair is read again, so is everything it includes, so the render thread gets
+ * the whole set & reload() doesn't read anything. New #includes start being watched as soon as they show up.
+ *
+ * We watch the directories rather than the files themselves. Most editors save by writing a new file and renaming it
+ * over the old one, which would silently kill a watch on the file.
+ *
+ * Usage:
+ *     ShaderWatcher watcher;
+ *     int watchID = watcher.watch("shader_lesson/basic.vs", "shader_lesson/shader1.fs", shaderProgram.includes());
+ *     ...every frame...
+ *     std::string vertexCode, fragmentCode;
+ *     std::vector<ShaderFile> includedFiles;
+ *     if (watcher.takeChanged(watchID, vertexCode, fragmentCode, includedFiles))
+ *         shaderProgram.reload(vertexCode, fragmentCode, &includedFiles);
+ */
+class ShaderWatcher
+{
+public:
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    /**
+     * Start watching a vertex/fragment pair & the files they include. Returns the id to pass to takeChanged,
+     * or -1 if inotify isn't available.
+     */
+    int watch(const std::string &vertexPath, const std::string &fragmentPath, const std::vector<std::string> &includes = std::vector<std::string>());
+
+    /**
+     * Render thread only. If any file of the pair changed since the last call, moves both sources & every file they
+     * include out & returns true. Never waits: if the watcher thread happens to hold the lock we just try again next frame.
+     */
+    bool takeChanged(int id, std::string &vertexCode, std::string &fragmentCode, std::vector<ShaderFile> &includedFiles);
+
+private:
+    struct Pair
+    {
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::vector<std::string> includes;
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::vector<ShaderFile> includedFiles;
+        bool changed = false;
+
+        bool uses(const std::string &path) const
+        {
+            bool used = path == vertexPath || path == fragmentPath;
+            for (const std::string &include : includes)
+            {
+                used = used || path == include;
+            }
+            return used;
+        }
+    };
+
+    struct Directory
+    {
+        int descriptor;
+        std::string path;
+    };
+
+    int inotifyFD;
+    std::vector<Pair> pairs;
+    std::vector<Directory> directories;
+    std::mutex lock;
+    std::atomic<bool> running;
+    std::thread thread;
+
+    void addDirectory(const std::string &path);
+    void run();
+    static std::string directoryOf(const std::string &path);
+};
+
+inline ShaderWatcher::ShaderWatcher() : running(false)
+{
+    inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFD == -1)
+    {
+        std::cout << "ERROR::SHADER::WATCHER::INOTIFY_INIT_FAILED, hot reload disabled" << std::endl;
+    }
+}
+
+inline ShaderWatcher::~ShaderWatcher()
+{
+    running = false;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    if (inotifyFD != -1)
+    {
+        close(inotifyFD);
+    }
+}
+
+inline std::string ShaderWatcher::directoryOf(const std::string &path)
+{
+    std::size_t slash = path.rfind('/');
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+inline void ShaderWatcher::addDirectory(const std::string &path)
+{
+    for (const Directory &directory : directories)
+    {
+        if (directory.path == path)
+        {
+            return;
+        }
+    }
+    // CLOSE_WRITE => saved in place, MOVED_TO => saved with a rename, CREATE => deleted & recreated
+    int descriptor = inotify_add_watch(inotifyFD, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (descriptor == -1)
+    {
+        std::cout << "ERROR::SHADER::WATCHER::CANNOT_WATCH " << path << std::endl;
+        return;
+    }
+    directories.push_back(Directory{descriptor, path});
+}
+
+inline int ShaderWatcher::watch(const std::string &vertexPath, const std::string &fragmentPath, const std::vector<std::string> &includes)
+{
+    if (inotifyFD == -1)
+    {
+        return -1;
+    }
+
+    int id;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        addDirectory(directoryOf(vertexPath));
+        addDirectory(directoryOf(fragmentPath));
+        for (const std::string &include : includes)
+        {
+            addDirectory(directoryOf(include));
+        }
+        Pair pair;
+        pair.vertexPath = vertexPath;
+        pair.fragmentPath = fragmentPath;
+        pair.includes = includes;
+        pairs.push_back(pair);
+        id = (int)pairs.size() - 1;
+    }
+
+    if (!running)
+    {
+        running = true;
+        thread = std::thread(&ShaderWatcher::run, this);
+    }
+    return id;
+}
+
+inline bool ShaderWatcher::takeChanged(int id, std::string &vertexCode, std::string &fragmentCode, std::vector<ShaderFile> &includedFiles)
+{
+    std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+    if (!guard.owns_lock() || id < 0 || id >= (int)pairs.size() || !pairs[id].changed)
+    {
+        return false;
+    }
+    Pair &pair = pairs[id];
+    vertexCode.swap(pair.vertexCode);
+    fragmentCode.swap(pair.fragmentCode);
+    includedFiles.swap(pair.includedFiles);
+    pair.vertexCode.clear();
+    pair.fragmentCode.clear();
+    pair.includedFiles.clear();
+    pair.changed = false;
+    return true;
+}
+
+/**
+ * Watcher thread. poll() with a timeout so the destructor doesn't wait more than a moment for us to notice it.
+ */
+inline void ShaderWatcher::run()
+{
+    // inotify events are variable length, this buffer fits plenty of them. Aligned the way `man inotify` asks.
+    alignas(struct inotify_event) char buffer[4096];
+    pollfd descriptor = {inotifyFD, POLLIN, 0};
+
+    while (running)
+    {
+        if (poll(&descriptor, 1, 100) <= 0)
+        {
+            continue;
+        }
+
+        // An editor save is usually a burst of events. Give it a moment to finish, then handle the whole burst at once.
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::vector<std::string> changedPaths;
+        ssize_t length;
+        while ((length = read(inotifyFD, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* next = buffer; next < buffer + length; )
+            {
+                const struct inotify_event* event = (const struct inotify_event*)next;
+                next += sizeof(struct inotify_event) + event->len;
+                if (event->len == 0)
+                {
+                    continue;
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                for (const Directory &directory : directories)
+                {
+                    if (directory.descriptor == event->wd)
+                    {
+                        changedPaths.push_back(directory.path == "." ? std::string(event->name) : directory.path + "/" + event->name);
+                    }
+                }
+            }
+        }
+
+        // Copy out which pairs we need while holding the lock, but do the actual file reading without it.
+        std::vector<Pair> toRead;
+        std::vector<int> ids;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (int i = 0; i < (int)pairs.size(); i++)
+            {
+                for (const std::string &path : changedPaths)
+                {
+                    if (pairs[i].uses(path))
+                    {
+                        toRead.push_back(pairs[i]);
+                        ids.push_back(i);
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < (int)toRead.size(); i++)
+        {
+            Pair &pair = toRead[i];
+            pair.includedFiles.clear(); // Might still hold a set the render thread hasn't taken yet
+            if (!readShaderFile(pair.vertexPath.c_str(), pair.vertexCode) || !readShaderFile(pair.fragmentPath.c_str(), pair.fragmentCode)
+                || !readShaderIncludes(pair.vertexCode, pair.vertexPath, pair.includedFiles)
+                || !readShaderIncludes(pair.fragmentCode, pair.fragmentPath, pair.includedFiles))
+            {
+                // Probably caught the file mid-rename. The next event for it will try again.
+                continue;
+            }
+            // The includes might not be the same ones anymore. Watch whatever they are now.
+            pair.includes.clear();
+            for (const ShaderFile &file : pair.includedFiles)
+            {
+                pair.includes.push_back(file.path);
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            for (const std::string &include : pair.includes)
+            {
+                addDirectory(directoryOf(include));
+            }
+            pairs[ids[i]].includes.swap(pair.includes);
+            pairs[ids[i]].vertexCode.swap(pair.vertexCode);
+            pairs[ids[i]].fragmentCode.swap(pair.fragmentCode);
+            pairs[ids[i]].includedFiles.swap(pair.includedFiles);
+            pairs[ids[i]].changed = true;
+            std::cout << "SHADER::WATCHER::CHANGED " << pair.vertexPath << ", " << pair.fragmentPath << std::endl;
+        }
+    }
+}
+
+#endif
@@ -270,12 +270,32 @@ RECENT REVISION HISTORY:
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// With GCC/Clang on x86, the JPEG IDCT, YCbCr->RGB conversion and the 2x2
+// chroma upsampler also have AVX2 versions (and AVX-512 versions of the last
+// two), compiled with target attributes and only used when the CPU reports
+// support at run time. They produce bit-identical results to the generic C
+// versions. Define STBI_NO_AVX2 to leave them out.
+//
+// PNG scanline unfiltering (Sub, Up, Average, Paeth) uses SSE2 for 3 to 8
+// byte pixels, with AVX2 versions of Up and Paeth picked the same way.
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
 // ===========================================================================
 //
+// zlib / PNG
+//
+// Huffman blocks are mostly decoded by a fast loop with a 64-bit bit buffer
+// and lookup tables that give up to two literals per lookup; the last few
+// symbols of the input or output go through the careful one-at-a-time loop.
+// PNG output is sized exactly from the header (interlaced ones too), so valid
+// files never realloc while inflating. Define STBI_NO_FAST_INFLATE to only use
+// the careful loop.
+//
+// ===========================================================================
+//
 // HDR image support   (disable by defining STBI_NO_HDR)
 //
 // stb_image supports loading HDR images in general, and currently the Radiance
@@ -643,12 +663,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -688,6 +710,13 @@ typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 #define STBI_REALLOC_SIZED(p,oldsz,newsz) STBI_REALLOC(p,newsz)
 #endif
 
+// applied to every image right before it's returned to the caller. a custom
+// allocator can use it to move the result somewhere else (stbi_arena.h moves it
+// out of its arena, so only the temporary buffers of a decode ever live there)
+#ifndef STBI_DETACH_RESULT
+#define STBI_DETACH_RESULT(p) (p)
+#endif
+
 // x86/x64 detection
 #if defined(__x86_64__) || defined(_M_X64)
 #define STBI__X64_TARGET
@@ -750,7 +779,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -761,7 +790,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -771,6 +800,30 @@ static int stbi__sse2_available(void)
 }
 #endif
 
+#endif
+
+// AVX2 / AVX-512 JPEG kernels and AVX2 PNG unfiltering. Only the
+// functions that use them are compiled for those instruction sets (target
+// attributes), so the rest of the library still runs on any SSE2 machine; the
+// kernels are chosen at run time.
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && !defined(STBI_NO_AVX2) && (defined(__GNUC__) || defined(__clang__)) && !defined(__MINGW32__)
+#define STBI_AVX2
+#include <immintrin.h>
+#define STBI__AVX2_TARGET   __attribute__((target("avx2")))
+#define STBI__AVX512_TARGET __attribute__((target("avx2,avx512f,avx512bw")))
+
+static int stbi__avx2_available(void)
+{
+   // also checks that the OS saves the ymm registers
+   return __builtin_cpu_supports("avx2");
+}
+
+#ifndef STBI_NO_JPEG
+static int stbi__avx512_available(void)
+{
+   return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+}
+#endif
 #endif
 #endif
 
@@ -1280,7 +1333,7 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
    }
 
-   return (unsigned char *) result;
+   return (unsigned char *) STBI_DETACH_RESULT(result);
 }
 
 static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
@@ -1307,7 +1360,7 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi__uint16));
    }
 
-   return (stbi__uint16 *) result;
+   return (stbi__uint16 *) STBI_DETACH_RESULT(result);
 }
 
 #if !defined(STBI_NO_HDR) && !defined(STBI_NO_LINEAR)
@@ -1451,8 +1504,10 @@ STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int *
    if (stbi__vertically_flip_on_load) {
       stbi__vertical_flip_slices( result, *x, *y, *z, *comp );
    }
+   if (delays && *delays)
+      *delays = (int *) STBI_DETACH_RESULT(*delays);
 
-   return result;
+   return (unsigned char *) STBI_DETACH_RESULT(result);
 }
 #endif
 
@@ -1466,12 +1521,12 @@ static float *stbi__loadf_main(stbi__context *s, int *x, int *y, int *comp, int
       float *hdr_data = stbi__hdr_load(s,x,y,comp,req_comp, &ri);
       if (hdr_data)
          stbi__float_postprocess(hdr_data,x,y,comp,req_comp);
-      return hdr_data;
+      return (float *) STBI_DETACH_RESULT(hdr_data);
    }
    #endif
    data = stbi__load_and_postprocess_8bit(s, x, y, comp, req_comp);
    if (data)
-      return stbi__ldr_to_hdr(data, *x, *y, req_comp ? req_comp : *comp);
+      return (float *) STBI_DETACH_RESULT(stbi__ldr_to_hdr(data, *x, *y, req_comp ? req_comp : *comp));
    return stbi__errpf("unknown image type", "Image not of any known type, or corrupt");
 }
 
@@ -2704,6 +2759,270 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 integer IDCT. unlike the sse2 version this is bit-identical to the
+// generic C version for *any* input, not just the range real jpegs produce:
+// the column pass uses 16x16->32 bit dot products (madd) on the inputs, which
+// is exact, and the row pass only does the same when every intermediate fits
+// in 16 bits, otherwise it runs the generic C math in 32-bit lanes.
+//
+// most of the time in an 8x8 IDCT goes into shuffling (transposes), so the
+// columns are kept in the order 0 4 2 6 | 1 3 5 7. packing two rows of that to
+// 16 bits lines up exactly the pairs the row pass needs, which saves the first
+// full transpose; the row pass then has the rows in order 0 2 4 6 | 1 3 5 7,
+// and the final byte transpose just stores them where they belong.
+STBI__AVX2_TARGET static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m256i row0, row1, row2, row3, row4, row5, row6, row7;
+
+   #define dct8_add(a,b)  _mm256_add_epi32((a),(b))
+   #define dct8_sub(a,b)  _mm256_sub_epi32((a),(b))
+   #define dct8_mul(a,c)  _mm256_mullo_epi32((a), _mm256_set1_epi32(c))
+
+   // out = a*c0 + b*c1 for interleaved 16-bit pairs (a,b), 32-bit out
+   #define dct8_madd(ab,c0,c1) _mm256_madd_epi16((ab), _mm256_set1_epi32((int) (((unsigned) (c1) << 16) | ((c0) & 0xffff))))
+
+   // the constants of STBI__IDCT_1D's odd part
+   #define dct8_k5  stbi__f2f( 1.175875602f)
+   #define dct8_ka  stbi__f2f( 0.298631336f)
+   #define dct8_kb  stbi__f2f( 2.053119869f)
+   #define dct8_kc  stbi__f2f( 3.072711026f)
+   #define dct8_kd  stbi__f2f( 1.501321110f)
+   #define dct8_ke  stbi__f2f(-0.899976223f)
+   #define dct8_kf  stbi__f2f(-2.562915447f)
+   #define dct8_kg  stbi__f2f(-1.961570560f)
+   #define dct8_kh  stbi__f2f(-0.390180644f)
+
+   // STBI__IDCT_1D on interleaved pairs (s0,s4) (s2,s6) (s1,s3) (s5,s7).
+   // the odd part is multiplied out so each output is one constant per input,
+   // which is the same integer math, just in a different order.
+   #define dct8_1d_madd(s04,s26,s13,s57) \
+      __m256i t0,t1,t2,t3,x0,x1,x2,x3; \
+      t2 = dct8_madd(s26, stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f)); \
+      t3 = dct8_madd(s26, stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f)); \
+      t0 = dct8_madd(s04, 4096, 4096); \
+      t1 = dct8_madd(s04, 4096, -4096); \
+      x0 = dct8_add(t0,t3); \
+      x3 = dct8_sub(t0,t3); \
+      x1 = dct8_add(t1,t2); \
+      x2 = dct8_sub(t1,t2); \
+      t3 = dct8_add(dct8_madd(s13, dct8_kd+dct8_k5+dct8_ke+dct8_kh, dct8_k5), dct8_madd(s57, dct8_k5+dct8_kh, dct8_k5+dct8_ke)); \
+      t2 = dct8_add(dct8_madd(s13, dct8_k5, dct8_kc+dct8_k5+dct8_kf+dct8_kg), dct8_madd(s57, dct8_k5+dct8_kf, dct8_k5+dct8_kg)); \
+      t1 = dct8_add(dct8_madd(s13, dct8_k5+dct8_kh, dct8_k5+dct8_kf), dct8_madd(s57, dct8_kb+dct8_k5+dct8_kf+dct8_kh, dct8_k5)); \
+      t0 = dct8_add(dct8_madd(s13, dct8_k5+dct8_ke, dct8_k5+dct8_kg), dct8_madd(s57, dct8_k5, dct8_ka+dct8_k5+dct8_ke+dct8_kg));
+
+   // STBI__IDCT_1D as written, on 32-bit lanes
+   #define dct8_1d_wide(s0,s1,s2,s3,s4,s5,s6,s7) \
+      __m256i t0,t1,t2,t3,p1,p2,p3,p4,p5,x0,x1,x2,x3; \
+      p2 = s2; \
+      p3 = s6; \
+      p1 = dct8_mul(dct8_add(p2,p3), stbi__f2f(0.5411961f)); \
+      t2 = dct8_add(p1, dct8_mul(p3, stbi__f2f(-1.847759065f))); \
+      t3 = dct8_add(p1, dct8_mul(p2, stbi__f2f( 0.765366865f))); \
+      p2 = s0; \
+      p3 = s4; \
+      t0 = _mm256_slli_epi32(dct8_add(p2,p3), 12); \
+      t1 = _mm256_slli_epi32(dct8_sub(p2,p3), 12); \
+      x0 = dct8_add(t0,t3); \
+      x3 = dct8_sub(t0,t3); \
+      x1 = dct8_add(t1,t2); \
+      x2 = dct8_sub(t1,t2); \
+      t0 = s7; \
+      t1 = s5; \
+      t2 = s3; \
+      t3 = s1; \
+      p3 = dct8_add(t0,t2); \
+      p4 = dct8_add(t1,t3); \
+      p1 = dct8_add(t0,t3); \
+      p2 = dct8_add(t1,t2); \
+      p5 = dct8_mul(dct8_add(p3,p4), dct8_k5); \
+      t0 = dct8_mul(t0, dct8_ka); \
+      t1 = dct8_mul(t1, dct8_kb); \
+      t2 = dct8_mul(t2, dct8_kc); \
+      t3 = dct8_mul(t3, dct8_kd); \
+      p1 = dct8_add(p5, dct8_mul(p1, dct8_ke)); \
+      p2 = dct8_add(p5, dct8_mul(p2, dct8_kf)); \
+      p3 = dct8_mul(p3, dct8_kg); \
+      p4 = dct8_mul(p4, dct8_kh); \
+      t3 = dct8_add(t3, dct8_add(p1,p4)); \
+      t2 = dct8_add(t2, dct8_add(p2,p3)); \
+      t1 = dct8_add(t1, dct8_add(p2,p4)); \
+      t0 = dct8_add(t0, dct8_add(p1,p3));
+
+   // butterfly the 1D results into row0..row7, add bias, then shift by "s"
+   #define dct8_bfly(bias,s) \
+      x0 = dct8_add(x0, bias); \
+      x1 = dct8_add(x1, bias); \
+      x2 = dct8_add(x2, bias); \
+      x3 = dct8_add(x3, bias); \
+      row0 = _mm256_srai_epi32(dct8_add(x0,t3), s); \
+      row7 = _mm256_srai_epi32(dct8_sub(x0,t3), s); \
+      row1 = _mm256_srai_epi32(dct8_add(x1,t2), s); \
+      row6 = _mm256_srai_epi32(dct8_sub(x1,t2), s); \
+      row2 = _mm256_srai_epi32(dct8_add(x2,t1), s); \
+      row5 = _mm256_srai_epi32(dct8_sub(x2,t1), s); \
+      row3 = _mm256_srai_epi32(dct8_add(x3,t0), s); \
+      row4 = _mm256_srai_epi32(dct8_sub(x3,t0), s);
+
+   // 16-bit rows a & b -> 32-bit lanes of (a[i], b[i]) pairs
+   #define dct8_pair16(a,b) \
+      _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((a),(b))), _mm_unpackhi_epi16((a),(b)), 1)
+
+   // 32-bit 8x8 transpose (only for the rare row pass that needs 32 bits)
+   #define dct8_transpose() \
+      { \
+         __m256i a0 = _mm256_unpacklo_epi32(row0, row1); \
+         __m256i a1 = _mm256_unpackhi_epi32(row0, row1); \
+         __m256i a2 = _mm256_unpacklo_epi32(row2, row3); \
+         __m256i a3 = _mm256_unpackhi_epi32(row2, row3); \
+         __m256i a4 = _mm256_unpacklo_epi32(row4, row5); \
+         __m256i a5 = _mm256_unpackhi_epi32(row4, row5); \
+         __m256i a6 = _mm256_unpacklo_epi32(row6, row7); \
+         __m256i a7 = _mm256_unpackhi_epi32(row6, row7); \
+         __m256i b0 = _mm256_unpacklo_epi64(a0, a2); \
+         __m256i b1 = _mm256_unpackhi_epi64(a0, a2); \
+         __m256i b2 = _mm256_unpacklo_epi64(a1, a3); \
+         __m256i b3 = _mm256_unpackhi_epi64(a1, a3); \
+         __m256i b4 = _mm256_unpacklo_epi64(a4, a6); \
+         __m256i b5 = _mm256_unpackhi_epi64(a4, a6); \
+         __m256i b6 = _mm256_unpacklo_epi64(a5, a7); \
+         __m256i b7 = _mm256_unpackhi_epi64(a5, a7); \
+         row0 = _mm256_permute2x128_si256(b0, b4, 0x20); \
+         row1 = _mm256_permute2x128_si256(b1, b5, 0x20); \
+         row2 = _mm256_permute2x128_si256(b2, b6, 0x20); \
+         row3 = _mm256_permute2x128_si256(b3, b7, 0x20); \
+         row4 = _mm256_permute2x128_si256(b0, b4, 0x31); \
+         row5 = _mm256_permute2x128_si256(b1, b5, 0x31); \
+         row6 = _mm256_permute2x128_si256(b2, b6, 0x31); \
+         row7 = _mm256_permute2x128_si256(b3, b7, 0x31); \
+      }
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // lane order of the column pass: columns 0 4 2 6 | 1 3 5 7
+   __m256i column_order = _mm256_setr_epi32(0, 4, 2, 6, 1, 3, 5, 7);
+
+   {
+      // column pass, straight from the 16-bit input
+      // (no all-zeroes shortcut needed, the full math gives the same dcterm)
+      __m128i in0 = _mm_load_si128((const __m128i *) (data + 0*8));
+      __m128i in1 = _mm_load_si128((const __m128i *) (data + 1*8));
+      __m128i in2 = _mm_load_si128((const __m128i *) (data + 2*8));
+      __m128i in3 = _mm_load_si128((const __m128i *) (data + 3*8));
+      __m128i in4 = _mm_load_si128((const __m128i *) (data + 4*8));
+      __m128i in5 = _mm_load_si128((const __m128i *) (data + 5*8));
+      __m128i in6 = _mm_load_si128((const __m128i *) (data + 6*8));
+      __m128i in7 = _mm_load_si128((const __m128i *) (data + 7*8));
+      __m256i s04 = _mm256_permutevar8x32_epi32(dct8_pair16(in0, in4), column_order);
+      __m256i s26 = _mm256_permutevar8x32_epi32(dct8_pair16(in2, in6), column_order);
+      __m256i s13 = _mm256_permutevar8x32_epi32(dct8_pair16(in1, in3), column_order);
+      __m256i s57 = _mm256_permutevar8x32_epi32(dct8_pair16(in5, in7), column_order);
+      dct8_1d_madd(s04, s26, s13, s57)
+      dct8_bfly(bias_0, 10)
+   }
+
+   {
+      // row pass. v + 0x8000 has no bits above the low 16 iff v fits in a short
+      __m256i offset = _mm256_set1_epi32(0x8000);
+      __m256i high = _mm256_or_si256(
+         _mm256_or_si256(_mm256_or_si256(_mm256_add_epi32(row0, offset), _mm256_add_epi32(row1, offset)),
+                         _mm256_or_si256(_mm256_add_epi32(row2, offset), _mm256_add_epi32(row3, offset))),
+         _mm256_or_si256(_mm256_or_si256(_mm256_add_epi32(row4, offset), _mm256_add_epi32(row5, offset)),
+                         _mm256_or_si256(_mm256_add_epi32(row6, offset), _mm256_add_epi32(row7, offset))));
+      if (_mm256_testz_si256(high, _mm256_set1_epi32((int) 0xffff0000))) {
+         // packing rows a & b gives 32-bit (c0,c4) (c2,c6) of a, then of b | (c1,c3) (c5,c7) of a, then of b.
+         // gather each kind of pair from all the rows (a 4x8 transpose of those 32-bit pairs)
+         __m256i q01 = _mm256_packs_epi32(row0, row1);
+         __m256i q23 = _mm256_packs_epi32(row2, row3);
+         __m256i q45 = _mm256_packs_epi32(row4, row5);
+         __m256i q67 = _mm256_packs_epi32(row6, row7);
+         __m256i u0 = _mm256_unpacklo_epi32(q01, q23);
+         __m256i u1 = _mm256_unpackhi_epi32(q01, q23);
+         __m256i u2 = _mm256_unpacklo_epi32(q45, q67);
+         __m256i u3 = _mm256_unpackhi_epi32(q45, q67);
+         __m256i g0 = _mm256_unpacklo_epi64(u0, u2); // (c0,c4) of rows 0 2 4 6 | (c1,c3) of rows 0 2 4 6
+         __m256i g1 = _mm256_unpackhi_epi64(u0, u2); // (c2,c6)                 | (c5,c7)
+         __m256i g2 = _mm256_unpacklo_epi64(u1, u3); // same for rows 1 3 5 7
+         __m256i g3 = _mm256_unpackhi_epi64(u1, u3);
+         __m256i s04 = _mm256_permute2x128_si256(g0, g2, 0x20);
+         __m256i s13 = _mm256_permute2x128_si256(g0, g2, 0x31);
+         __m256i s26 = _mm256_permute2x128_si256(g1, g3, 0x20);
+         __m256i s57 = _mm256_permute2x128_si256(g1, g3, 0x31);
+         dct8_1d_madd(s04, s26, s13, s57)
+         dct8_bfly(bias_1, 17)
+      } else {
+         // transposed, register j holds column column_order[j] of rows 0..7
+         __m256i row_order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+         dct8_transpose();
+         {
+            dct8_1d_wide(row0, row4, row2, row5, row1, row6, row3, row7)
+            dct8_bfly(bias_1, 17)
+         }
+         row0 = _mm256_permutevar8x32_epi32(row0, row_order);
+         row1 = _mm256_permutevar8x32_epi32(row1, row_order);
+         row2 = _mm256_permutevar8x32_epi32(row2, row_order);
+         row3 = _mm256_permutevar8x32_epi32(row3, row_order);
+         row4 = _mm256_permutevar8x32_epi32(row4, row_order);
+         row5 = _mm256_permutevar8x32_epi32(row5, row_order);
+         row6 = _mm256_permutevar8x32_epi32(row6, row_order);
+         row7 = _mm256_permutevar8x32_epi32(row7, row_order);
+      }
+   }
+
+   {
+      // now register k holds output column k of rows 0 2 4 6 | 1 3 5 7.
+      // saturating packs clamp to 0..255 just like stbi__clamp, giving bytes
+      // (col 0 of 4 rows, col 1 of 4 rows, ...) in each half; transpose those
+      // 4x4 blocks with a shuffle and join the left & right 4 columns.
+      __m256i transpose4 = _mm256_setr_epi8(0,4,8,12, 1,5,9,13, 2,6,10,14, 3,7,11,15, 0,4,8,12, 1,5,9,13, 2,6,10,14, 3,7,11,15);
+      __m256i left  = _mm256_packus_epi16(_mm256_packs_epi32(row0, row1), _mm256_packs_epi32(row2, row3));
+      __m256i right = _mm256_packus_epi16(_mm256_packs_epi32(row4, row5), _mm256_packs_epi32(row6, row7));
+      __m256i lo, hi;
+      left  = _mm256_shuffle_epi8(left, transpose4);
+      right = _mm256_shuffle_epi8(right, transpose4);
+      lo = _mm256_unpacklo_epi32(left, right); // rows 0 2 | 1 3
+      hi = _mm256_unpackhi_epi32(left, right); // rows 4 6 | 5 7
+
+      // store
+      {
+         __m128i r02 = _mm256_castsi256_si128(lo);
+         __m128i r13 = _mm256_extracti128_si256(lo, 1);
+         __m128i r46 = _mm256_castsi256_si128(hi);
+         __m128i r57 = _mm256_extracti128_si256(hi, 1);
+         _mm_storel_epi64((__m128i *) out, r02); out += out_stride;
+         _mm_storel_epi64((__m128i *) out, r13); out += out_stride;
+         _mm_storeh_pd((double *) out, _mm_castsi128_pd(r02)); out += out_stride;
+         _mm_storeh_pd((double *) out, _mm_castsi128_pd(r13)); out += out_stride;
+         _mm_storel_epi64((__m128i *) out, r46); out += out_stride;
+         _mm_storel_epi64((__m128i *) out, r57); out += out_stride;
+         _mm_storeh_pd((double *) out, _mm_castsi128_pd(r46)); out += out_stride;
+         _mm_storeh_pd((double *) out, _mm_castsi128_pd(r57));
+      }
+   }
+
+#undef dct8_add
+#undef dct8_sub
+#undef dct8_mul
+#undef dct8_madd
+#undef dct8_k5
+#undef dct8_ka
+#undef dct8_kb
+#undef dct8_kc
+#undef dct8_kd
+#undef dct8_ke
+#undef dct8_kf
+#undef dct8_kg
+#undef dct8_kh
+#undef dct8_1d_madd
+#undef dct8_1d_wide
+#undef dct8_bfly
+#undef dct8_pair16
+#undef dct8_transpose
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -3643,6 +3962,114 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+// same filter as stbi__resample_row_hv_2_simd, 16 pixels at a time. picks up
+// at pixel i (with t1 = the vertically filtered pixel before it) and also
+// finishes the row, so the avx-512 version can hand over its leftovers.
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2_from(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int i, int t1)
+{
+   int t0;
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass: 3*near + far = 4*near + (far - near)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // prev/next = curr shifted by one pixel across the whole register
+      // (alignr only shifts within 128-bit halves, so bring the other half in
+      // first), with the pixels either side of this block put in the ends.
+      __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+      __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+      __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+      __m256i next = _mm256_insert_epi16(nxt0, 3*in_near[i+16] + in_far[i+16], 15);
+
+      // horizontal filter, polyphase like the sse2 version
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curs = _mm256_slli_epi16(curr, 2);
+      __m256i prvd = _mm256_sub_epi16(prev, curr);
+      __m256i nxtd = _mm256_sub_epi16(next, curr);
+      __m256i curb = _mm256_add_epi16(curs, bias);
+      __m256i even = _mm256_add_epi16(prvd, curb);
+      __m256i odd  = _mm256_add_epi16(nxtd, curb);
+
+      // interleave even and odd pixels, undo scaling. unpack and pack both
+      // stay within 128-bit halves, so the output comes out in order.
+      __m256i de0  = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i de1  = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(de0, de1));
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   return out;
+}
+
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   STBI_NOTUSED(hs);
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+   return stbi__resample_row_hv_2_avx2_from(out, in_near, in_far, w, 0, 3*in_near[0] + in_far[0]);
+}
+
+// 32 pixels at a time. the one-pixel shifts are single cross-lane permutes
+// here, pulling the neighbouring pixel from a second register.
+STBI__AVX512_TARGET static stbi_uc *stbi__resample_row_hv_2_avx512(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   static const short prev_index[32] = { 32, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30 };
+   static const short next_index[32] = {  1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32 };
+   int i=0,t1;
+
+   STBI_NOTUSED(hs);
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   {
+      __m512i prev_perm = _mm512_loadu_si512(prev_index);
+      __m512i next_perm = _mm512_loadu_si512(next_index);
+      __m512i bias = _mm512_set1_epi16(8);
+      for (; i < ((w-1) & ~31); i += 32) {
+         __m512i farw  = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *) (in_far + i)));
+         __m512i nearw = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *) (in_near + i)));
+         __m512i curr  = _mm512_add_epi16(_mm512_slli_epi16(nearw, 2), _mm512_sub_epi16(farw, nearw));
+
+         __m512i prev = _mm512_permutex2var_epi16(curr, prev_perm, _mm512_set1_epi16((short) t1));
+         __m512i next = _mm512_permutex2var_epi16(curr, next_perm, _mm512_set1_epi16((short) (3*in_near[i+32] + in_far[i+32])));
+
+         __m512i curs = _mm512_slli_epi16(curr, 2);
+         __m512i curb = _mm512_add_epi16(curs, bias);
+         __m512i even = _mm512_add_epi16(_mm512_sub_epi16(prev, curr), curb);
+         __m512i odd  = _mm512_add_epi16(_mm512_sub_epi16(next, curr), curb);
+
+         __m512i de0  = _mm512_srli_epi16(_mm512_unpacklo_epi16(even, odd), 4);
+         __m512i de1  = _mm512_srli_epi16(_mm512_unpackhi_epi16(even, odd), 4);
+         _mm512_storeu_si512((void *) (out + i*2), _mm512_packus_epi16(de0, de1));
+
+         t1 = 3*in_near[i+31] + in_far[i+31];
+      }
+   }
+   return stbi__resample_row_hv_2_avx2_from(out, in_near, in_far, w, i, t1);
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3817,6 +4244,147 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// 16 pixels at a time, same math as the sse2 version. unlike that one this
+// also does step == 3 (which is what you get loading a jpeg with 0 or 3
+// requested channels): drop the alpha bytes with a shuffle and only store
+// the 48 bytes that belong to these pixels.
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 3 || step == 4) {
+      __m128i signflip  = _mm_set1_epi8(-0x80);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(8); // what the sse2 version gets from (y<<8 | 128) >> 4
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+      __m256i drop_alpha = _mm256_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1, 0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+      __m256i rgb_order  = _mm256_setr_epi32(0,1,2,4,5,6,3,7);
+      __m256i rgb_mask   = _mm256_setr_epi32(-1,-1,-1,-1,-1,-1,0,0);
+
+      for (; i+15 < count; i += 16) {
+         // load
+         __m128i y_bytes = _mm_loadu_si128((__m128i *) (y+i));
+         __m128i cr_biased = _mm_xor_si128(_mm_loadu_si128((__m128i *) (pcr+i)), signflip); // -128
+         __m128i cb_biased = _mm_xor_si128(_mm_loadu_si128((__m128i *) (pcb+i)), signflip); // -128
+
+         // widen to short, scaled like the sse2 version
+         __m256i yws = _mm256_add_epi16(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 4), y_bias);
+         __m256i crw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(cr_biased), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(cb_biased), 8);
+
+         // color transform
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte & interleave channels, within 128-bit halves:
+         // o0 = pixels 0-3 | 8-11, o1 = pixels 4-7 | 12-15
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+         __m256i p0 = _mm256_permute2x128_si256(o0, o1, 0x20); // pixels 0-7
+         __m256i p1 = _mm256_permute2x128_si256(o0, o1, 0x31); // pixels 8-15
+
+         // store
+         if (step == 4) {
+            _mm256_storeu_si256((__m256i *) (out + 0), p0);
+            _mm256_storeu_si256((__m256i *) (out + 32), p1);
+         } else {
+            p0 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(p0, drop_alpha), rgb_order);
+            p1 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(p1, drop_alpha), rgb_order);
+            _mm256_maskstore_epi32((int *) (out + 0), rgb_mask, p0);
+            _mm256_maskstore_epi32((int *) (out + 24), rgb_mask, p1);
+         }
+         out += 16*step;
+      }
+   }
+
+   stbi__YCbCr_to_RGB_row(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+
+// 32 pixels at a time; step == 3 uses a masked store instead.
+STBI__AVX512_TARGET static void stbi__YCbCr_to_RGB_avx512(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 3 || step == 4) {
+      __m256i signflip  = _mm256_set1_epi8(-0x80);
+      __m512i cr_const0 = _mm512_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m512i cr_const1 = _mm512_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m512i cb_const0 = _mm512_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m512i cb_const1 = _mm512_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m512i y_bias = _mm512_set1_epi16(8);
+      __m512i xw = _mm512_set1_epi16(255);
+      static const signed char drop_alpha_bytes[64] = {
+         0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1, 0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1,
+         0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1, 0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1 };
+      __m512i drop_alpha = _mm512_loadu_si512(drop_alpha_bytes);
+      __m512i rgb_order  = _mm512_setr_epi32(0,1,2,4,5,6,8,9,10,12,13,14,3,7,11,15);
+      __m512i first_half  = _mm512_setr_epi64(0,1,8,9,2,3,10,11);
+      __m512i second_half = _mm512_setr_epi64(4,5,12,13,6,7,14,15);
+
+      for (; i+31 < count; i += 32) {
+         __m256i y_bytes = _mm256_loadu_si256((__m256i *) (y+i));
+         __m256i cr_biased = _mm256_xor_si256(_mm256_loadu_si256((__m256i *) (pcr+i)), signflip);
+         __m256i cb_biased = _mm256_xor_si256(_mm256_loadu_si256((__m256i *) (pcb+i)), signflip);
+
+         __m512i yws = _mm512_add_epi16(_mm512_slli_epi16(_mm512_cvtepu8_epi16(y_bytes), 4), y_bias);
+         __m512i crw = _mm512_slli_epi16(_mm512_cvtepi8_epi16(cr_biased), 8);
+         __m512i cbw = _mm512_slli_epi16(_mm512_cvtepi8_epi16(cb_biased), 8);
+
+         __m512i rws = _mm512_add_epi16(_mm512_mulhi_epi16(cr_const0, crw), yws);
+         __m512i gws = _mm512_add_epi16(_mm512_add_epi16(_mm512_mulhi_epi16(cb_const0, cbw), yws), _mm512_mulhi_epi16(crw, cr_const1));
+         __m512i bws = _mm512_add_epi16(yws, _mm512_mulhi_epi16(cbw, cb_const1));
+
+         __m512i rw = _mm512_srai_epi16(rws, 4);
+         __m512i bw = _mm512_srai_epi16(bws, 4);
+         __m512i gw = _mm512_srai_epi16(gws, 4);
+
+         // 128-bit lane k of o0 = pixels 8k..8k+3, of o1 = 8k+4..8k+7
+         __m512i brb = _mm512_packus_epi16(rw, bw);
+         __m512i gxb = _mm512_packus_epi16(gw, xw);
+         __m512i t0 = _mm512_unpacklo_epi8(brb, gxb);
+         __m512i t1 = _mm512_unpackhi_epi8(brb, gxb);
+         __m512i o0 = _mm512_unpacklo_epi16(t0, t1);
+         __m512i o1 = _mm512_unpackhi_epi16(t0, t1);
+         __m512i p0 = _mm512_permutex2var_epi64(o0, first_half, o1);  // pixels 0-15
+         __m512i p1 = _mm512_permutex2var_epi64(o0, second_half, o1); // pixels 16-31
+
+         if (step == 4) {
+            _mm512_storeu_si512((void *) (out + 0), p0);
+            _mm512_storeu_si512((void *) (out + 64), p1);
+         } else {
+            // (the maskz form only because gcc 12 warns about the plain one's undefined source)
+            p0 = _mm512_maskz_permutexvar_epi32(0xffff, rgb_order, _mm512_shuffle_epi8(p0, drop_alpha));
+            p1 = _mm512_maskz_permutexvar_epi32(0xffff, rgb_order, _mm512_shuffle_epi8(p1, drop_alpha));
+            _mm512_mask_storeu_epi32((void *) (out + 0), 0x0fff, p0);
+            _mm512_mask_storeu_epi32((void *) (out + 48), 0x0fff, p1);
+         }
+         out += 32*step;
+      }
+   }
+
+   stbi__YCbCr_to_RGB_avx2(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -3832,6 +4400,19 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
+   if (stbi__avx512_available()) {
+      // no avx-512 IDCT: one 8x8 block doesn't fill the wider registers any better
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx512;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx512;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -4092,6 +4673,24 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
+// fast inflate loop (define STBI_NO_FAST_INFLATE to only use the careful one):
+// a 64-bit bit buffer refilled 8 bytes at a time, and per-block tables with
+// STBI__ZFAST2_BITS bits of lookahead whose entries give up to two literals,
+// or a length/distance with its extra bit count, in one lookup.
+#ifndef STBI_NO_FAST_INFLATE
+#define STBI__ZFAST2_BITS 11
+#define STBI__ZFAST2_MASK ((1 << STBI__ZFAST2_BITS) - 1)
+
+// table entries: bits 0-7 code length, 8-11 kind, 12-15 extra bits, 16-31 value
+#define STBI__ZSLOW   0 // longer than the table, or not a valid code: decode the slow way
+#define STBI__ZLIT    1 // one literal, value = the byte
+#define STBI__ZLIT2   2 // two literals (bits 16-23, 24-31), code length = both codes
+#define STBI__ZLEN    3 // length code, value = base length
+#define STBI__ZEOB    4 // end of block
+#define STBI__ZDIST   5 // distance code, value = base distance
+#define STBI__ZKIND(e)  (((e) >> 8) & 15)
+#endif
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -4187,6 +4786,10 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+#ifndef STBI_NO_FAST_INFLATE
+   stbi__uint32 fast_length[1 << STBI__ZFAST2_BITS];
+   stbi__uint32 fast_distance[1 << STBI__ZFAST2_BITS];
+#endif
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
@@ -4306,11 +4909,222 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+#ifndef STBI_NO_FAST_INFLATE
+static stbi__uint32 stbi__zfast_entry(int symbol, int size, int distance)
+{
+   stbi__uint32 s = (stbi__uint32) size;
+   if (distance) {
+      if (symbol >= 30) return STBI__ZSLOW; // invalid, the slow way reports it
+      return s | (STBI__ZDIST << 8) | (stbi__zdist_extra[symbol] << 12) | ((stbi__uint32) stbi__zdist_base[symbol] << 16);
+   }
+   if (symbol < 256)  return s | (STBI__ZLIT << 8) | ((stbi__uint32) symbol << 16);
+   if (symbol == 256) return s | (STBI__ZEOB << 8);
+   if (symbol >= 286) return STBI__ZSLOW;
+   symbol -= 257;
+   return s | (STBI__ZLEN << 8) | (stbi__zlength_extra[symbol] << 12) | ((stbi__uint32) stbi__zlength_base[symbol] << 16);
+}
+
+// same canonical codes as stbi__zbuild_huffman (which has already checked the
+// sizes), into a fast loop table
+static void stbi__zbuild_fast(stbi__uint32 *table, const stbi_uc *sizelist, int num, int distance)
+{
+   int i, code = 0, next_code[16], sizes[16];
+   memset(sizes, 0, sizeof(sizes));
+   memset(table, 0, sizeof(stbi__uint32) << STBI__ZFAST2_BITS);
+   for (i=0; i < num; ++i)
+      ++sizes[sizelist[i]];
+   sizes[0] = 0;
+   for (i=1; i < 16; ++i) {
+      next_code[i] = code;
+      code = (code + sizes[i]) << 1;
+   }
+   for (i=0; i < num; ++i) {
+      int s = sizelist[i];
+      if (s) {
+         if (s <= STBI__ZFAST2_BITS) {
+            stbi__uint32 entry = stbi__zfast_entry(i, s, distance);
+            int j = stbi__bit_reverse(next_code[s], s);
+            for (; j < (1 << STBI__ZFAST2_BITS); j += 1 << s)
+               table[j] = entry;
+         }
+         ++next_code[s];
+      }
+   }
+   if (!distance) {
+      // where a literal's code leaves room for another literal's whole code,
+      // decode both at once. the second one is the single entry at the
+      // remaining bits; going from the top, that entry hasn't been paired yet.
+      for (i = (1 << STBI__ZFAST2_BITS) - 1; i >= 0; --i) {
+         stbi__uint32 first = table[i];
+         if (STBI__ZKIND(first) == STBI__ZLIT) {
+            int s = first & 255;
+            stbi__uint32 second = table[i >> s];
+            if (STBI__ZKIND(second) == STBI__ZLIT && s + (int) (second & 255) <= STBI__ZFAST2_BITS)
+               table[i] = (stbi__uint32) (s + (second & 255)) | (STBI__ZLIT2 << 8) | (first & 0xff0000) | ((second & 0xff0000) << 8);
+         }
+      }
+   }
+}
+
+// little-endian 64-bit load (compilers turn this into a single load)
+stbi_inline static stbi__uint64 stbi__zload64(const stbi_uc *p)
+{
+   return  (stbi__uint64) p[0]        | ((stbi__uint64) p[1] <<  8) | ((stbi__uint64) p[2] << 16) | ((stbi__uint64) p[3] << 24)
+        | ((stbi__uint64) p[4] << 32) | ((stbi__uint64) p[5] << 40) | ((stbi__uint64) p[6] << 48) | ((stbi__uint64) p[7] << 56);
+}
+
+// codes the table doesn't resolve: same search as stbi__zhuffman_decode_slowpath
+static int stbi__zdecode_long(const stbi__zhuffman *z, stbi__uint64 bits, int *size)
+{
+   int b,s,k;
+   k = stbi__bit_reverse((int) (bits & 0xffff), 16);
+   for (s=STBI__ZFAST_BITS+1; ; ++s)
+      if (k < z->maxcode[s])
+         break;
+   if (s >= 16) return -1;
+   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   if (b < 0 || b >= STBI__ZNSYMS || z->size[b] != s) return -1; // b < 0: a hole in an incomplete code
+   *size = s;
+   return z->value[b];
+}
+
+// the bulk of a huffman block. runs while there are at least 8 bytes of input
+// and room for the longest match plus 8 bytes of output, so it can refill and
+// copy without bounds checks. returns 1 at the end of the block, 0 on error,
+// or 2 to let the careful loop do the last few symbols.
+static int stbi__parse_huffman_block_fast(stbi__zbuf *a)
+{
+   stbi__uint64 bits = a->code_buffer;
+   int num_bits = a->num_bits;
+   stbi_uc *in = a->zbuffer;
+   char *zout = a->zout;
+   const stbi__uint32 *lengths = a->fast_length;
+   const stbi__uint32 *distances = a->fast_distance;
+   int result = 2;
+
+   while (a->zbuffer_end - in >= 8 && a->zout_end - zout >= 258 + 8) {
+      stbi__uint32 e;
+      int s, n, len, dist;
+      char *p;
+
+      // refill to 56..63 bits, which covers the longest length + distance
+      // with all their extra bits (15+5+15+13)
+      bits |= stbi__zload64(in) << num_bits;
+      in += (63 - num_bits) >> 3;
+      num_bits |= 56;
+
+      e = lengths[bits & STBI__ZFAST2_MASK];
+      if (STBI__ZKIND(e) - 1u < 2u) {
+         // literals: up to three lookups (of up to 11 bits) per refill
+         n = 3;
+         do {
+            s = e & 255;
+            bits >>= s;
+            num_bits -= s;
+            zout[0] = (char) (e >> 16);
+            zout[1] = (char) (e >> 24); // only kept for STBI__ZLIT2, which is 2
+            zout += STBI__ZKIND(e);
+            e = lengths[bits & STBI__ZFAST2_MASK];
+         } while (--n && STBI__ZKIND(e) - 1u < 2u);
+         continue;
+      }
+
+      if (STBI__ZKIND(e) == STBI__ZLEN) {
+         s = e & 255;
+         bits >>= s;
+         num_bits -= s;
+         s = (e >> 12) & 15;
+         len = (int) (e >> 16) + (int) (bits & ((1u << s) - 1));
+      } else if (STBI__ZKIND(e) == STBI__ZEOB) {
+         s = e & 255;
+         bits >>= s;
+         num_bits -= s;
+         result = 1;
+         break;
+      } else {
+         int z = stbi__zdecode_long(&a->z_length, bits, &s);
+         if (z < 0 || z >= 286) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+         bits >>= s;
+         num_bits -= s;
+         if (z < 256) {
+            *zout++ = (char) z;
+            continue;
+         }
+         if (z == 256) {
+            result = 1;
+            break;
+         }
+         z -= 257;
+         s = stbi__zlength_extra[z];
+         len = stbi__zlength_base[z] + (int) (bits & ((1u << s) - 1));
+      }
+      bits >>= s;
+      num_bits -= s;
+
+      e = distances[bits & STBI__ZFAST2_MASK];
+      if (e) {
+         s = e & 255;
+         bits >>= s;
+         num_bits -= s;
+         s = (e >> 12) & 15;
+         dist = (int) (e >> 16) + (int) (bits & ((1u << s) - 1));
+      } else {
+         int z = stbi__zdecode_long(&a->z_distance, bits, &s);
+         if (z < 0 || z >= 30) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+         bits >>= s;
+         num_bits -= s;
+         s = stbi__zdist_extra[z];
+         dist = stbi__zdist_base[z] + (int) (bits & ((1u << s) - 1));
+      }
+      bits >>= s;
+      num_bits -= s;
+
+      if (zout - a->zout_start < dist) { result = stbi__err("bad dist","Corrupt PNG"); break; }
+      p = zout - dist;
+      if (dist >= 8) {
+         // 8 bytes at a time, possibly writing up to 7 past the match (there's room)
+         char *end = zout + len;
+         do {
+            memcpy(zout, p, 8);
+            zout += 8;
+            p += 8;
+         } while (zout < end);
+         zout = end;
+      } else if (dist == 1) {
+         memset(zout, *p, len);
+         zout += len;
+      } else {
+         do *zout++ = *p++; while (--len);
+      }
+   }
+
+   // give back the whole bytes read ahead, leaving the state the careful
+   // loop (and stored blocks) expect: under 8 bits, nothing above them
+   in -= num_bits >> 3;
+   num_bits &= 7;
+   a->code_buffer = (stbi__uint32) (bits & ((1u << num_bits) - 1));
+   a->num_bits = num_bits;
+   a->zbuffer = in;
+   a->zout = zout;
+   return result;
+}
+#endif
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+#ifndef STBI_NO_FAST_INFLATE
+      if (a->zbuffer_end - a->zbuffer >= 8 && a->zout_end - zout >= 258 + 8) {
+         int r;
+         a->zout = zout;
+         r = stbi__parse_huffman_block_fast(a);
+         if (r != 2) return r;
+         zout = a->zout;
+      }
+#endif
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4403,6 +5217,10 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
    if (n != ntot) return stbi__err("bad codelengths","Corrupt PNG");
    if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
    if (!stbi__zbuild_huffman(&a->z_distance, lencodes+hlit, hdist)) return 0;
+#ifndef STBI_NO_FAST_INFLATE
+   stbi__zbuild_fast(a->fast_length, lencodes, hlit, 0);
+   stbi__zbuild_fast(a->fast_distance, lencodes+hlit, hdist, 1);
+#endif
    return 1;
 }
 
@@ -4498,6 +5316,10 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
             // use fixed code lengths
             if (!stbi__zbuild_huffman(&a->z_length  , stbi__zdefault_length  , STBI__ZNSYMS)) return 0;
             if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance,  32)) return 0;
+#ifndef STBI_NO_FAST_INFLATE
+            stbi__zbuild_fast(a->fast_length, stbi__zdefault_length, STBI__ZNSYMS, 0);
+            stbi__zbuild_fast(a->fast_distance, stbi__zdefault_distance, 32, 1);
+#endif
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
@@ -4667,6 +5489,110 @@ static int stbi__paeth(int a, int b, int c)
    return t1;
 }
 
+#ifdef STBI_SSE2
+// SIMD unfiltering, for pixels of 3 to 8 bytes (8-bit RGB/RGBA, 16-bit
+// grey+alpha/RGB/RGBA). Sub, Average and Paeth depend on the pixel to the
+// left, so they still go one pixel at a time, but a whole pixel per step
+// instead of a byte at a time. Up has no such dependency and goes 16 bytes
+// (AVX2: 32) at a time, for any pixel size.
+//
+// Each kernel starts at byte k and returns how far it got; the scalar loops
+// finish the row. Pixels are loaded & stored as 8 bytes (the bytes past the
+// pixel are junk that the next pixel overwrites), so they stop 8 bytes short
+// of the end of the row and never touch memory outside it. That includes the
+// first load of the pixel to the left, so rows of fewer than 8 bytes past k
+// (e.g. a 1 or 2 pixel wide RGB image) are left entirely to the scalar loops.
+
+static int stbi__unfilter_sub_sse2(stbi_uc *cur, stbi_uc *raw, int k, int nk, int bpp)
+{
+   __m128i a;
+   if (k + 8 > nk) return k;
+   a = _mm_loadl_epi64((__m128i *) (cur + k - bpp));
+   for (; k + 8 <= nk; k += bpp) {
+      a = _mm_add_epi8(a, _mm_loadl_epi64((__m128i *) (raw + k)));
+      _mm_storel_epi64((__m128i *) (cur + k), a);
+   }
+   return k;
+}
+
+static int stbi__unfilter_up_sse2(stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int nk)
+{
+   int k;
+   for (k=0; k + 16 <= nk; k += 16) {
+      __m128i b = _mm_loadu_si128((__m128i *) (prior + k));
+      _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(_mm_loadu_si128((__m128i *) (raw + k)), b));
+   }
+   return k;
+}
+
+static int stbi__unfilter_avg_sse2(stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int k, int nk, int bpp)
+{
+   __m128i a, one = _mm_set1_epi8(1);
+   if (k + 8 > nk) return k;
+   a = _mm_loadl_epi64((__m128i *) (cur + k - bpp));
+   for (; k + 8 <= nk; k += bpp) {
+      __m128i b = _mm_loadl_epi64((__m128i *) (prior + k));
+      // (a+b)>>1 in 8 bits: pavgb rounds up, so take the odd bit back off
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(_mm_loadl_epi64((__m128i *) (raw + k)), avg);
+      _mm_storel_epi64((__m128i *) (cur + k), a);
+   }
+   return k;
+}
+
+// Paeth in 16-bit lanes, same formulation as stbi__paeth: only thresh and the
+// min/max depend on the pixel to the left, so the chain from one pixel to the
+// next stays short. select(m,x,y) = m ? x : y per lane.
+#define STBI__UNFILTER_PAETH(select) \
+   __m128i zero = _mm_setzero_si128(); \
+   __m128i bytes = _mm_set1_epi16(255); \
+   __m128i a, c; \
+   if (k + 8 > nk) return k; \
+   a = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (cur + k - bpp)), zero); \
+   c = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (prior + k - bpp)), zero); \
+   for (; k + 8 <= nk; k += bpp) { \
+      __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (prior + k)), zero); \
+      __m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (raw + k)), zero); \
+      __m128i thresh = _mm_sub_epi16(_mm_sub_epi16(_mm_add_epi16(c, _mm_add_epi16(c, c)), b), a); \
+      __m128i lo = _mm_min_epi16(a, b); \
+      __m128i hi = _mm_max_epi16(a, b); \
+      __m128i t0 = select(_mm_cmpgt_epi16(hi, thresh), c, lo); \
+      __m128i t1 = select(_mm_cmpgt_epi16(thresh, lo), t0, hi); \
+      a = _mm_and_si128(_mm_add_epi16(t1, d), bytes); \
+      _mm_storel_epi64((__m128i *) (cur + k), _mm_packus_epi16(a, a)); \
+      c = b; \
+   } \
+   return k;
+
+#define STBI__SELECT_SSE2(m,x,y)  _mm_or_si128(_mm_and_si128(m, x), _mm_andnot_si128(m, y))
+
+static int stbi__unfilter_paeth_sse2(stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int k, int nk, int bpp)
+{
+   STBI__UNFILTER_PAETH(STBI__SELECT_SSE2)
+}
+
+
+#ifdef STBI_AVX2
+// same loop, but VEX encoded and with blendv for the selects
+#define STBI__SELECT_AVX2(m,x,y)  _mm_blendv_epi8(y, x, m)
+
+STBI__AVX2_TARGET static int stbi__unfilter_paeth_avx2(stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int k, int nk, int bpp)
+{
+   STBI__UNFILTER_PAETH(STBI__SELECT_AVX2)
+}
+
+STBI__AVX2_TARGET static int stbi__unfilter_up_avx2(stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int nk)
+{
+   int k;
+   for (k=0; k + 32 <= nk; k += 32) {
+      __m256i b = _mm256_loadu_si256((__m256i *) (prior + k));
+      _mm256_storeu_si256((__m256i *) (cur + k), _mm256_add_epi8(_mm256_loadu_si256((__m256i *) (raw + k)), b));
+   }
+   return k;
+}
+#endif
+#endif // STBI_SSE2
+
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // adds an extra all-255 alpha channel
@@ -4707,6 +5633,11 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+#ifdef STBI_SSE2
+   int (*simd_up)(stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int nk) = NULL;
+   int (*simd_paeth)(stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int k, int nk, int bpp) = NULL;
+   int simd_pixels = 0; // Sub/Average/Paeth kernels apply
+#endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
    a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4734,6 +5665,20 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       width = img_width_bytes;
    }
 
+#ifdef STBI_SSE2
+   if (stbi__sse2_available()) {
+      simd_up = stbi__unfilter_up_sse2;
+      simd_paeth = stbi__unfilter_paeth_sse2;
+      simd_pixels = filter_bytes >= 3;
+   }
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      simd_up = stbi__unfilter_up_avx2;
+      simd_paeth = stbi__unfilter_paeth_avx2;
+   }
+#endif
+#endif
+
    for (j=0; j < y; ++j) {
       // cur/prior filter buffers alternate
       stbi_uc *cur = filter_buf + (j & 1)*img_width_bytes;
@@ -4758,23 +5703,37 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          break;
       case STBI__F_sub:
          memcpy(cur, raw, filter_bytes);
-         for (k = filter_bytes; k < nk; ++k)
+         k = filter_bytes;
+#ifdef STBI_SSE2
+         if (simd_pixels) k = stbi__unfilter_sub_sse2(cur, raw, k, nk, filter_bytes);
+#endif
+         for (; k < nk; ++k)
             cur[k] = STBI__BYTECAST(raw[k] + cur[k-filter_bytes]);
          break;
       case STBI__F_up:
-         for (k = 0; k < nk; ++k)
+         k = 0;
+#ifdef STBI_SSE2
+         if (simd_up) k = simd_up(cur, prior, raw, nk);
+#endif
+         for (; k < nk; ++k)
             cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
          break;
       case STBI__F_avg:
          for (k = 0; k < filter_bytes; ++k)
             cur[k] = STBI__BYTECAST(raw[k] + (prior[k]>>1));
-         for (k = filter_bytes; k < nk; ++k)
+#ifdef STBI_SSE2
+         if (simd_pixels) k = stbi__unfilter_avg_sse2(cur, prior, raw, k, nk, filter_bytes);
+#endif
+         for (; k < nk; ++k)
             cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k-filter_bytes])>>1));
          break;
       case STBI__F_paeth:
          for (k = 0; k < filter_bytes; ++k)
             cur[k] = STBI__BYTECAST(raw[k] + prior[k]); // prior[k] == stbi__paeth(0,prior[k],0)
-         for (k = filter_bytes; k < nk; ++k)
+#ifdef STBI_SSE2
+         if (simd_pixels) k = simd_paeth(cur, prior, raw, k, nk, filter_bytes);
+#endif
+         for (; k < nk; ++k)
             cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k-filter_bytes], prior[k], prior[k-filter_bytes]));
          break;
       case STBI__F_avg_first:
@@ -5201,9 +6160,23 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
-            // initial guess for decoded data size to avoid unnecessary reallocs
-            bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
-            raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+            // exact decoded data size (from IHDR), so inflating never has to realloc
+            if (interlace) {
+               // each Adam7 pass is its own little image with its own filter bytes
+               int p;
+               raw_len = 0;
+               for (p=0; p < 7; ++p) {
+                  static const int xorig[] = { 0,4,0,2,0,1,0 }, yorig[] = { 0,0,4,0,2,0,1 };
+                  static const int xspc[]  = { 8,8,4,4,2,2,1 }, yspc[]  = { 8,8,8,4,4,2,2 };
+                  stbi__uint32 x = (s->img_x - xorig[p] + xspc[p]-1) / xspc[p];
+                  stbi__uint32 y = (s->img_y - yorig[p] + yspc[p]-1) / yspc[p];
+                  if (x && y)
+                     raw_len += (((s->img_n * x * z->depth) + 7) / 8 + 1) * y;
+               }
+            } else {
+               bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
+               raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+            }
             z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
             if (z->expanded == NULL) return 0; // zlib should set error
             STBI_FREE(z->idata); z->idata = NULL;
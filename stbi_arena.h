@@ -0,0 +1,299 @@
+#ifndef STBI_ARENA_H
+#define STBI_ARENA_H
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <iostream>
+
+#include <sys/resource.h>
+
+/**
+ * -- stb_image Arena --
+ * stb_image mallocs & reallocs every buffer it needs while decoding (the zlib output grows one realloc at a time,
+ * each JPEG component plane, the format conversion...) and frees most of them right after. Decode a few hundred
+ * images and that's thousands of heap calls of all sizes, which fragments the heap.
+ *
+ * Include this BEFORE stb_image.h (where STB_IMAGE_IMPLEMENTATION is defined) and all of that goes to a bump
+ * allocator instead, one per thread:
+ *   - malloc moves a pointer forward. free just counts down. Nothing is ever given back to the heap one by one.
+ *   - realloc of the newest block (which is what zlib keeps doing) grows it in place.
+ *   - The image stbi is about to return gets moved out to the heap (STBI_DETACH_RESULT, one malloc & memcpy), so
+ *     once stbi returns, everything it left in the arena has been freed and the next decode starts from the
+ *     beginning of the same memory again. Callers can hold on to as many images as they like, the arena only ever
+ *     needs room for the temporary buffers of one decode.
+ * stbi_image_free of a moved out image is a plain free(), on whichever thread.
+ *
+ * stbiArenaEnabled = false sends everything straight to malloc/realloc/free again (still counted) for comparing.
+ */
+
+struct StbiArenaStats
+{
+    std::atomic<std::size_t> allocations{0};  // STBI_MALLOC + STBI_REALLOC calls
+    std::atomic<std::size_t> heapAllocations{0}; // Of those (plus new chunks), how many reached malloc/realloc
+    std::atomic<std::size_t> resets{0};       // Times an arena went back to the start
+    std::atomic<std::size_t> chunkBytes{0};   // Held by all the arenas right now
+    std::atomic<std::size_t> peakChunkBytes{0}; // High-water mark of chunkBytes
+
+    void print() const
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        std::cout << "STBI::ARENA " << allocations << " allocations, " << heapAllocations << " hit the heap, " << resets
+                  << " resets, arena peak " << peakChunkBytes / (1024 * 1024) << "MB, peak RSS " << usage.ru_maxrss / 1024 << "MB" << std::endl;
+    }
+};
+
+inline StbiArenaStats stbiArenaStats;
+inline bool stbiArenaEnabled = true;
+
+class StbiArena
+{
+public:
+    void* allocate(std::size_t size);
+    void* reallocate(void* pointer, std::size_t size);
+    static void release(void* pointer);
+
+    // The thread's own arena (made on first use)
+    static StbiArena* current();
+
+    // In front of every block. 16 bytes, so what we return stays 16 byte aligned for SSE.
+    struct Header
+    {
+        StbiArena* owner;
+        std::size_t size;
+    };
+    static_assert(sizeof(Header) == 16, "Header keeps blocks 16 byte aligned");
+
+private:
+    struct Chunk
+    {
+        unsigned char* memory;
+        std::size_t capacity;
+    };
+
+    static const std::size_t CHUNK_BYTES = 8 * 1024 * 1024;
+
+    std::vector<Chunk> chunks;
+    std::size_t chunk = 0;  // Chunk we're bumping through
+    std::size_t used = 0;   // Bytes used in it
+    Header* newest = NULL;  // Last block handed out, the only one realloc can grow in place
+    // Blocks not yet freed, +1 while the thread is alive. Whoever takes it to 0 deletes the arena.
+    std::atomic<std::size_t> references{1};
+
+    ~StbiArena();
+    void rewindIfEmpty();
+    Header* bump(std::size_t size);
+
+    friend struct StbiArenaOwner;
+};
+
+// Lets go of the thread's reference when the thread exits. Images it decoded can outlive it.
+struct StbiArenaOwner
+{
+    StbiArena* arena = NULL;
+    ~StbiArenaOwner()
+    {
+        if (arena != NULL && --arena->references == 0)
+        {
+            delete arena;
+        }
+    }
+};
+
+inline StbiArena* StbiArena::current()
+{
+    thread_local StbiArenaOwner owner;
+    if (owner.arena == NULL)
+    {
+        owner.arena = new StbiArena();
+    }
+    return owner.arena;
+}
+
+inline StbiArena::~StbiArena()
+{
+    for (Chunk &c : chunks)
+    {
+        stbiArenaStats.chunkBytes -= c.capacity;
+        std::free(c.memory);
+    }
+}
+
+// Only the owning thread ever moves the bump pointer, other threads only count down.
+inline void StbiArena::rewindIfEmpty()
+{
+    if (references == 1 && (used != 0 || chunk != 0))
+    {
+        chunk = 0;
+        used = 0;
+        newest = NULL;
+        stbiArenaStats.resets++;
+    }
+}
+
+inline StbiArena::Header* StbiArena::bump(std::size_t size)
+{
+    std::size_t needed = (sizeof(Header) + size + 15) / 16 * 16;
+    while (chunk < chunks.size() && used + needed > chunks[chunk].capacity)
+    {
+        chunk++;
+        used = 0;
+    }
+    if (chunk == chunks.size())
+    {
+        std::size_t capacity = needed > CHUNK_BYTES ? needed : CHUNK_BYTES;
+        unsigned char* memory = (unsigned char*)std::malloc(capacity);
+        if (memory == NULL)
+        {
+            return NULL;
+        }
+        stbiArenaStats.heapAllocations++;
+        std::size_t total = stbiArenaStats.chunkBytes += capacity;
+        std::size_t peak = stbiArenaStats.peakChunkBytes;
+        while (total > peak && !stbiArenaStats.peakChunkBytes.compare_exchange_weak(peak, total))
+        {
+        }
+        chunks.push_back(Chunk{memory, capacity});
+        used = 0;
+    }
+    Header* header = (Header*)(chunks[chunk].memory + used);
+    used += needed;
+    header->owner = this;
+    header->size = size;
+    newest = header;
+    references++;
+    return header;
+}
+
+inline void* StbiArena::allocate(std::size_t size)
+{
+    stbiArenaStats.allocations++;
+    if (!stbiArenaEnabled)
+    {
+        stbiArenaStats.heapAllocations++;
+        Header* header = (Header*)std::malloc(sizeof(Header) + size);
+        if (header == NULL)
+        {
+            return NULL;
+        }
+        header->owner = NULL;
+        header->size = size;
+        return header + 1;
+    }
+    rewindIfEmpty();
+    Header* header = bump(size);
+    return header == NULL ? NULL : header + 1;
+}
+
+inline void* StbiArena::reallocate(void* pointer, std::size_t size)
+{
+    if (pointer == NULL)
+    {
+        return allocate(size);
+    }
+    stbiArenaStats.allocations++;
+    Header* header = (Header*)pointer - 1;
+    if (header->owner == NULL)
+    {
+        stbiArenaStats.heapAllocations++;
+        Header* grown = (Header*)std::realloc(header, sizeof(Header) + size);
+        if (grown == NULL)
+        {
+            return NULL;
+        }
+        grown->size = size;
+        return grown + 1;
+    }
+
+    // Newest block of this thread's arena with room behind it: just move the end
+    if (header->owner == this && header == newest)
+    {
+        unsigned char* start = (unsigned char*)header;
+        std::size_t offset = start - chunks[chunk].memory;
+        std::size_t needed = (sizeof(Header) + size + 15) / 16 * 16;
+        if (offset + needed <= chunks[chunk].capacity)
+        {
+            used = offset + needed;
+            header->size = size;
+            return pointer;
+        }
+    }
+
+    Header* moved = bump(size);
+    if (moved == NULL)
+    {
+        return NULL;
+    }
+    std::memcpy(moved + 1, pointer, header->size < size ? header->size : size);
+    release(pointer);
+    return moved + 1;
+}
+
+inline void StbiArena::release(void* pointer)
+{
+    if (pointer == NULL)
+    {
+        return;
+    }
+    Header* header = (Header*)pointer - 1;
+    if (header->owner == NULL)
+    {
+        std::free(header);
+        return;
+    }
+    StbiArena* owner = header->owner;
+    if (--owner->references == 0)
+    {
+        delete owner;
+    }
+}
+
+// What STBI_DETACH_RESULT does: a block from an arena moves to the heap, so the arena doesn't have to keep it.
+inline void* stbiArenaDetach(void* pointer)
+{
+    if (pointer == NULL)
+    {
+        return NULL;
+    }
+    StbiArena::Header* header = (StbiArena::Header*)pointer - 1;
+    if (header->owner == NULL)
+    {
+        return pointer; // On the heap already (stbiArenaEnabled = false)
+    }
+    StbiArena::Header* moved = (StbiArena::Header*)std::malloc(sizeof(StbiArena::Header) + header->size);
+    if (moved == NULL)
+    {
+        return pointer; // Still works from the arena, it just can't rewind until it's freed
+    }
+    stbiArenaStats.heapAllocations++;
+    moved->owner = NULL;
+    moved->size = header->size;
+    std::memcpy(moved + 1, pointer, header->size);
+    StbiArena::release(pointer);
+    return moved + 1;
+}
+
+inline void* stbiArenaMalloc(std::size_t size)
+{
+    return StbiArena::current()->allocate(size);
+}
+
+inline void* stbiArenaRealloc(void* pointer, std::size_t size)
+{
+    return StbiArena::current()->reallocate(pointer, size);
+}
+
+inline void stbiArenaFree(void* pointer)
+{
+    StbiArena::release(pointer);
+}
+
+#define STBI_MALLOC(size) stbiArenaMalloc(size)
+#define STBI_REALLOC(pointer, size) stbiArenaRealloc(pointer, size)
+#define STBI_FREE(pointer) stbiArenaFree(pointer)
+#define STBI_DETACH_RESULT(pointer) stbiArenaDetach(pointer)
+
+#endif
@@ -0,0 +1,182 @@
+/**
+ * -- PNG Unfilter Test --
+ * Encodes small PNGs (every width from 1 to 40 pixels, 8 & 16 bit, 1 to 4 channels, every row filter) and checks
+ * stb_image decodes each one back to the exact pixels. The SIMD unfilter kernels work 8 bytes at a time, so the
+ * narrow ones (a 1x1 or 2x3 RGB image is only 3 or 6 bytes a row) are the interesting cases. make test builds this
+ * with AddressSanitizer and stb_image's default malloc, so reading past the end of a row fails it too.
+ * Run with `make test`.
+ */
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+bool check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        std::cout << "TEST::PNG_UNFILTER::FAILED " << what << std::endl;
+    }
+    return ok;
+}
+
+unsigned int crc32(const unsigned char* data, std::size_t size, unsigned int crc = 0)
+{
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+void putU32(std::vector<unsigned char> &out, unsigned int value)
+{
+    out.push_back((unsigned char)(value >> 24));
+    out.push_back((unsigned char)(value >> 16));
+    out.push_back((unsigned char)(value >> 8));
+    out.push_back((unsigned char)value);
+}
+
+void putChunk(std::vector<unsigned char> &png, const char* type, const std::vector<unsigned char> &data)
+{
+    putU32(png, (unsigned int)data.size());
+    std::size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+    putU32(png, crc32(&png[start], png.size() - start));
+}
+
+int paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+/**
+ * A PNG of `pixels` (big endian samples, rows of width * bpp bytes), each row filtered with the filter after the
+ * previous row's, starting at `firstFilter`. The zlib stream is stored blocks, so there's nothing to get wrong there.
+ */
+std::vector<unsigned char> encodePNG(const std::vector<unsigned char> &pixels, int width, int height, int channels, int depth, int firstFilter)
+{
+    static const unsigned char colorTypes[5] = {0, 0, 4, 2, 6};
+    int bpp = channels * depth / 8;
+    int rowBytes = width * bpp;
+
+    std::vector<unsigned char> filtered;
+    for (int y = 0; y < height; y++)
+    {
+        int filter = (firstFilter + y) % 5;
+        const unsigned char* row = &pixels[y * rowBytes];
+        const unsigned char* prior = y > 0 ? row - rowBytes : NULL;
+        filtered.push_back((unsigned char)filter);
+        for (int i = 0; i < rowBytes; i++)
+        {
+            int a = i >= bpp ? row[i - bpp] : 0;
+            int b = prior ? prior[i] : 0;
+            int c = prior && i >= bpp ? prior[i - bpp] : 0;
+            int predicted = filter == 1 ? a : filter == 2 ? b : filter == 3 ? (a + b) / 2 : filter == 4 ? paeth(a, b, c) : 0;
+            filtered.push_back((unsigned char)(row[i] - predicted));
+        }
+    }
+
+    std::vector<unsigned char> zlib = {0x78, 0x01};
+    std::size_t at = 0;
+    do
+    {
+        std::size_t length = filtered.size() - at < 65535 ? filtered.size() - at : 65535;
+        zlib.push_back(at + length == filtered.size() ? 1 : 0);
+        zlib.push_back((unsigned char)length);
+        zlib.push_back((unsigned char)(length >> 8));
+        zlib.push_back((unsigned char)~length);
+        zlib.push_back((unsigned char)(~length >> 8));
+        zlib.insert(zlib.end(), filtered.begin() + at, filtered.begin() + at + length);
+        at += length;
+    } while (at < filtered.size());
+    unsigned int s1 = 1, s2 = 0;
+    for (unsigned char byte : filtered)
+    {
+        s1 = (s1 + byte) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    putU32(zlib, (s2 << 16) | s1);
+
+    std::vector<unsigned char> header;
+    putU32(header, (unsigned int)width);
+    putU32(header, (unsigned int)height);
+    header.push_back((unsigned char)depth);
+    header.push_back(colorTypes[channels]);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    putChunk(png, "IHDR", header);
+    putChunk(png, "IDAT", zlib);
+    putChunk(png, "IEND", std::vector<unsigned char>());
+    return png;
+}
+
+int main()
+{
+    bool ok = true;
+    int images = 0;
+    unsigned int seed = 1;
+    for (int depth = 8; depth <= 16; depth += 8)
+    {
+        for (int channels = 1; channels <= 4; channels++)
+        {
+            for (int width = 1; width <= 40; width++)
+            {
+                // 3 rows is enough for every filter to follow every other one somewhere across the widths
+                for (int firstFilter = 0; firstFilter < 5; firstFilter++)
+                {
+                    int height = 3;
+                    int bpp = channels * depth / 8;
+                    std::vector<unsigned char> pixels(width * height * bpp);
+                    for (unsigned char &byte : pixels)
+                    {
+                        seed = seed * 1103515245u + 12345u;
+                        byte = (unsigned char)(seed >> 16);
+                    }
+                    std::vector<unsigned char> png = encodePNG(pixels, width, height, channels, depth, firstFilter);
+
+                    int w, h, n;
+                    std::string name = std::to_string(width) + "x" + std::to_string(height) + " " + std::to_string(depth) +
+                        "-bit " + std::to_string(channels) + " channel, first filter " + std::to_string(firstFilter);
+                    bool same = false;
+                    if (depth == 8)
+                    {
+                        stbi_uc* decoded = stbi_load_from_memory(png.data(), (int)png.size(), &w, &h, &n, 0);
+                        same = decoded && w == width && h == height && n == channels &&
+                            std::memcmp(decoded, pixels.data(), pixels.size()) == 0;
+                        stbi_image_free(decoded);
+                    }
+                    else
+                    {
+                        stbi_us* decoded = stbi_load_16_from_memory(png.data(), (int)png.size(), &w, &h, &n, 0);
+                        same = decoded && w == width && h == height && n == channels;
+                        for (std::size_t i = 0; same && i < pixels.size() / 2; i++)
+                        {
+                            same = decoded[i] == ((pixels[i * 2] << 8) | pixels[i * 2 + 1]);
+                        }
+                        stbi_image_free(decoded);
+                    }
+                    ok = check(same, name) && ok;
+                    images++;
+                }
+            }
+        }
+    }
+    std::cout << (ok ? "TEST::PNG_UNFILTER::PASSED " : "TEST::PNG_UNFILTER::FAILED ") << images << " PNGs decode to their pixels" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+/**
+ * -- Second Translation Unit --
+ * Linked into every test next to the test's own .cpp, which includes the same headers. Everything the headers define
+ * has to be inline (or a template), or this fails to link with "multiple definition" errors. Only headers that don't
+ * need a GL context are here, since the tests build without one.
+ */
+#include "../stbi_arena.h"
+#include "../stb_image.h"
+#include "../image_loader.h"
+#include "../mip_generator.h"
+#include "../texture_compression.h"
+#include "../shader_watcher.h" // Also brings in shader_preprocessor.h & shader_source.h
@@ -0,0 +1,65 @@
+/**
+ * -- stb_image Arena Test --
+ * Decodes the same images over & over while holding on to earlier results, the way the streamer & loadImages do,
+ * and checks the arenas stay the size of one decode's temporary buffers instead of growing with every image kept.
+ * Run with `make test`.
+ */
+#include "../stbi_arena.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+#include "../image_loader.h"
+
+#include <cstdlib>
+
+// The temporaries of one 512x512 decode fit in a chunk. A couple of chunks leaves room for an oversized one.
+const std::size_t ARENA_LIMIT = 2 * 8 * 1024 * 1024;
+
+bool check(bool ok, const char* what)
+{
+    std::cout << (ok ? "TEST::ARENA::PASSED " : "TEST::ARENA::FAILED ") << what << std::endl;
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    std::vector<unsigned char> file;
+    if (!readTextureFile("texture_lesson/container.jpg", file))
+    {
+        std::cout << "TEST::ARENA::FAILED can't read texture_lesson/container.jpg (run from the repo root)" << std::endl;
+        return 1;
+    }
+
+    // One image always alive while the next one decodes, like a worker whose last image hasn't been uploaded yet
+    stbi_uc* held = NULL;
+    std::size_t resetsBefore = stbiArenaStats.resets;
+    for (int i = 0; i < 200; i++)
+    {
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &channels, 0);
+        if (pixels == NULL)
+        {
+            return check(false, "decode failed") ? 0 : 1;
+        }
+        stbi_image_free(held);
+        held = pixels;
+    }
+    stbi_image_free(held);
+    ok = check(stbiArenaStats.resets - resetsBefore >= 199, "arena rewinds between decodes while an image is held") && ok;
+    ok = check(stbiArenaStats.peakChunkBytes <= ARENA_LIMIT, "arena high-water mark stays bounded, one image held") && ok;
+
+    // Every image of a batch alive at once, on a pool of threads
+    std::vector<ImageRequest> requests(64, ImageRequest{"texture_lesson/container.jpg"});
+    requests.push_back(ImageRequest{"texture_lesson/awesomeface.png"});
+    std::vector<LoadedImage> images = loadImages(requests, 2);
+    bool decoded = true;
+    for (const LoadedImage &image : images)
+    {
+        decoded = decoded && image.pixels;
+    }
+    ok = check(decoded, "loadImages decodes every request") && ok;
+    ok = check(stbiArenaStats.peakChunkBytes <= 2 * ARENA_LIMIT, "arena high-water mark stays bounded, 65 images held on 2 threads") && ok;
+
+    stbiArenaStats.print();
+    return ok ? 0 : 1;
+}
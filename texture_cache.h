@@ -0,0 +1,173 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "texture_streamer.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <iostream>
+
+/**
+ * -- Texture Cache --
+ * One place that owns every texture. Asking for the same file twice (with the same params) gives back the same
+ * texture instead of decoding & uploading it again. Paths go through realpath() first, so "texture_lesson/../x.jpg"
+ * and "texture_lesson/x.jpg" are the same file.
+ *
+ * Handles are shared_ptrs: while anyone holds one the texture stays alive. Once nobody does, it stays in the cache
+ * (in case someone asks again) until the total estimated VRAM goes over the budget, then the least recently used
+ * unreferenced textures get deleted first. Textures that failed to load are deleted as soon as nobody holds them,
+ * so asking for the file again tries again.
+ *
+ * Usage:
+ *     TextureCache textures(streamer, 256 * 1024 * 1024);
+ *     TextureRef container = textures.get("texture_lesson/container.jpg");
+ *     ...every frame...
+ *     textures.update();
+ *     textures.bind(container, 0); // Also counts as a use for the LRU
+ */
+struct CachedTexture
+{
+    unsigned int ID;
+    std::string key;
+    std::size_t bytes;      // Estimated VRAM incl. mips, 0 until the streamer finishes it
+    std::uint64_t lastUsed; // Frame number
+    bool failed;            // The streamer couldn't load it, ID is just the grey placeholder
+};
+
+typedef std::shared_ptr<CachedTexture> TextureRef;
+
+class TextureCache
+{
+public:
+    TextureCache(TextureStreamer &streamer, std::size_t budgetBytes = 256 * 1024 * 1024);
+
+    // The texture for this file + params, loading it through the streamer the first time.
+    TextureRef get(const std::string &path, bool flip = false, const TextureParams &params = TextureParams());
+
+    // glActiveTexture + glBindTexture, and marks it used this frame
+    void bind(const TextureRef &texture, int unit);
+
+    // Once per frame: picks up sizes of finished textures, drops failed ones & evicts down to the budget.
+    void update();
+
+    std::size_t usedBytes() const { return used; }
+    std::size_t budget;
+
+private:
+    TextureStreamer &streamer;
+    std::vector<TextureRef> entries;
+    std::size_t used;
+    std::uint64_t frame;
+    bool warnedOverBudget;
+
+    static std::string makeKey(const std::string &path, bool flip, const TextureParams &params);
+    void evict();
+};
+
+inline TextureCache::TextureCache(TextureStreamer &streamer, std::size_t budgetBytes) : budget(budgetBytes), streamer(streamer), used(0), frame(0), warnedOverBudget(false)
+{
+}
+
+inline std::string TextureCache::makeKey(const std::string &path, bool flip, const TextureParams &params)
+{
+    char resolved[PATH_MAX];
+    std::string key = realpath(path.c_str(), resolved) != NULL ? std::string(resolved) : path;
+    key += "|" + std::to_string(flip) + "|" + std::to_string(params.wrapS) + "," + std::to_string(params.wrapT) + "," + std::to_string(params.minFilter) + "," + std::to_string(params.magFilter)
+         + "|" + std::to_string(params.mipFilter) + "," + std::to_string(params.gammaCorrectMips) + "," + std::to_string(params.compression) + "," + std::to_string(params.srgb);
+    return key;
+}
+
+inline TextureRef TextureCache::get(const std::string &path, bool flip, const TextureParams &params)
+{
+    std::string key = makeKey(path, flip, params);
+    for (const TextureRef &entry : entries)
+    {
+        if (entry->key == key)
+        {
+            entry->lastUsed = frame;
+            return entry;
+        }
+    }
+    TextureRef entry = std::make_shared<CachedTexture>(CachedTexture{streamer.load(path, flip, params), key, 0, frame, false});
+    entries.push_back(entry);
+    return entry;
+}
+
+inline void TextureCache::bind(const TextureRef &texture, int unit)
+{
+    texture->lastUsed = frame;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture->ID);
+}
+
+inline void TextureCache::update()
+{
+    frame++;
+    for (const TextureRef &entry : entries)
+    {
+        if (entry->bytes == 0 && !entry->failed)
+        {
+            std::size_t bytes = streamer.gpuBytes(entry->ID);
+            entry->failed = bytes == TextureStreamer::LOAD_FAILED;
+            entry->bytes = entry->failed ? 0 : bytes;
+            used += entry->bytes;
+        }
+    }
+    evict();
+}
+
+inline void TextureCache::evict()
+{
+    // Failed loads take next to no VRAM, so they'd never come up below. Nothing to keep them around for either.
+    for (std::size_t i = 0; i < entries.size(); )
+    {
+        if (entries[i]->failed && entries[i].use_count() == 1)
+        {
+            TextureRef entry = entries[i];
+            entries[i] = entries.back();
+            entries.pop_back();
+            streamer.forget(entry->ID);
+            glDeleteTextures(1, &entry->ID);
+            continue;
+        }
+        i++;
+    }
+
+    while (used > budget)
+    {
+        // Oldest texture that only the cache holds & that has actually finished loading. Not many textures, so a scan is fine.
+        int oldest = -1;
+        for (int i = 0; i < (int)entries.size(); i++)
+        {
+            const TextureRef &entry = entries[i];
+            if (entry.use_count() == 1 && entry->bytes > 0 && (oldest == -1 || entry->lastUsed < entries[oldest]->lastUsed))
+            {
+                oldest = i;
+            }
+        }
+        if (oldest == -1)
+        {
+            // Everything left is in use. Nothing we can do but say so (once).
+            if (!warnedOverBudget)
+            {
+                std::cout << "ERROR::TEXTURE::CACHE::OVER_BUDGET " << used / (1024 * 1024) << "MB in use, budget is " << budget / (1024 * 1024) << "MB" << std::endl;
+                warnedOverBudget = true;
+            }
+            return;
+        }
+
+        TextureRef entry = entries[oldest];
+        entries[oldest] = entries.back();
+        entries.pop_back();
+        used -= entry->bytes;
+        streamer.forget(entry->ID);
+        glDeleteTextures(1, &entry->ID);
+    }
+    warnedOverBudget = false;
+}
+
+#endif
@@ -0,0 +1,676 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+/**
+ * -- Block Compression (BC1 / BC3 / BC7) --
+ * An uncompressed RGBA texel is 4 bytes of VRAM, and every one of them goes over the memory bus each time it's
+ * sampled. GPUs can sample block compressed formats directly, where every 4x4 texels get squeezed into a fixed size:
+ *   BC1 (DXT1) - 8 bytes per block,  0.5 byte/texel. Two 565 colors + 2 bit index per texel. No alpha. 8x smaller than RGBA.
+ *   BC3 (DXT5) - 16 bytes per block, 1 byte/texel.   BC1 for color + a separate 8 value alpha ramp. 4x smaller.
+ *   BC7        - 16 bytes per block, 1 byte/texel.   Much better quality than BC3. We only write mode 6 (one RGBA
+ *                line with 4 bit indices), which is simple and does well on smooth pictures.
+ *
+ * The encoder fits a line through each block's colors (principal axis), snaps the ends to what the format can
+ * store & picks the nearest point on that line for every texel. BC1 then re-fits the ends to those picks with least
+ * squares. It won't beat a dedicated encoder, but it's fast enough to run at bake time or on a decode thread.
+ * Block rows are split across threads.
+ *
+ * The decoders are the CPU fallback for drivers without S3TC/BPTC: the blocks get expanded to plain RGBA before upload.
+ * The BC7 decoder only understands mode 6, i.e. what our encoder writes.
+ */
+
+enum TextureCompression
+{
+    TEXTURE_UNCOMPRESSED = 0,
+    TEXTURE_BC1 = 1,
+    TEXTURE_BC3 = 3,
+    TEXTURE_BC7 = 7
+};
+
+inline int compressedBlockBytes(TextureCompression compression)
+{
+    return compression == TEXTURE_BC1 ? 8 : 16;
+}
+
+inline std::size_t compressedTextureBytes(TextureCompression compression, int width, int height)
+{
+    return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * compressedBlockBytes(compression);
+}
+
+// -- Shared helpers --
+
+// One 4x4 block as RGBA, repeating the last row/column for blocks hanging off the edge of the image.
+inline void loadCompressionBlock(const unsigned char* pixels, int width, int height, int channels, int blockX, int blockY, unsigned char block[16][4])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        int sy = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++)
+        {
+            int sx = std::min(blockX * 4 + x, width - 1);
+            const unsigned char* texel = pixels + ((std::size_t)sy * width + sx) * channels;
+            unsigned char* out = block[y * 4 + x];
+            if (channels <= 2)
+            {
+                // Grey (+ alpha)
+                out[0] = out[1] = out[2] = texel[0];
+                out[3] = channels == 2 ? texel[1] : 255;
+            }
+            else
+            {
+                out[0] = texel[0];
+                out[1] = texel[1];
+                out[2] = texel[2];
+                out[3] = channels == 4 ? texel[3] : 255;
+            }
+        }
+    }
+}
+
+/**
+ * Principal axis (largest spread) of `count` points with `dimensions` components, by power iteration on the covariance.
+ * Writes the mean & unit axis, returns false if all the points are the same.
+ */
+inline bool compressionPrincipalAxis(const float points[16][4], int dimensions, float mean[4], float axis[4])
+{
+    for (int d = 0; d < 4; d++)
+    {
+        mean[d] = 0.0f;
+        axis[d] = 0.0f;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        for (int d = 0; d < dimensions; d++)
+        {
+            mean[d] += points[i][d] / 16.0f;
+        }
+    }
+    float covariance[4][4] = {};
+    float low[4] = {255, 255, 255, 255}, high[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 16; i++)
+    {
+        for (int a = 0; a < dimensions; a++)
+        {
+            low[a] = std::min(low[a], points[i][a]);
+            high[a] = std::max(high[a], points[i][a]);
+            for (int b = 0; b < dimensions; b++)
+            {
+                covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+            }
+        }
+    }
+    // The bounding box diagonal is a good first guess & avoids starting orthogonal to the answer
+    for (int d = 0; d < dimensions; d++)
+    {
+        axis[d] = high[d] - low[d];
+    }
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < dimensions; a++)
+        {
+            for (int b = 0; b < dimensions; b++)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-8f)
+        {
+            break;
+        }
+        length = std::sqrt(length);
+        for (int d = 0; d < dimensions; d++)
+        {
+            axis[d] = next[d] / length;
+        }
+    }
+    float length = 0.0f;
+    for (int d = 0; d < dimensions; d++)
+    {
+        length += axis[d] * axis[d];
+    }
+    if (length < 1e-8f)
+    {
+        return false;
+    }
+    length = std::sqrt(length);
+    for (int d = 0; d < dimensions; d++)
+    {
+        axis[d] /= length;
+    }
+    return true;
+}
+
+// Ends of the line through the block along its principal axis, clamped to 0..255
+inline void compressionEndpoints(const float points[16][4], int dimensions, float start[4], float end[4])
+{
+    float mean[4], axis[4];
+    if (!compressionPrincipalAxis(points, dimensions, mean, axis))
+    {
+        for (int d = 0; d < 4; d++)
+        {
+            start[d] = end[d] = mean[d];
+        }
+        return;
+    }
+    float low = 1e9f, high = -1e9f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int d = 0; d < dimensions; d++)
+        {
+            t += (points[i][d] - mean[d]) * axis[d];
+        }
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+    for (int d = 0; d < 4; d++)
+    {
+        start[d] = std::min(std::max(mean[d] + axis[d] * high, 0.0f), 255.0f);
+        end[d] = std::min(std::max(mean[d] + axis[d] * low, 0.0f), 255.0f);
+    }
+}
+
+// -- BC1 color block --
+
+inline unsigned short packColor565(const float color[3])
+{
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+inline void unpackColor565(unsigned short packed, int color[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// The 4 colors a BC1 block can use. `fourColor` is the color0 > color1 case, otherwise index 3 is transparent black.
+inline void bc1Palette(unsigned short color0, unsigned short color1, bool fourColor, int palette[4][4])
+{
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    for (int c = 0; c < 3; c++)
+    {
+        if (fourColor)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[3][3] = fourColor ? 255 : 0;
+}
+
+// Nearest palette entry for every texel. Returns the total squared error.
+inline int bc1PickIndices(const unsigned char block[16][4], unsigned short color0, unsigned short color1, int indices[16])
+{
+    int palette[4][4];
+    bc1Palette(color0, color1, true, palette);
+    int total = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = 1 << 30;
+        for (int p = 0; p < 4; p++)
+        {
+            int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (error < bestError)
+            {
+                best = p;
+                bestError = error;
+            }
+        }
+        indices[i] = best;
+        total += bestError;
+    }
+    return total;
+}
+
+/**
+ * Least squares endpoints for fixed indices: every texel is a0 * start + a1 * end with (a0, a1) from its index,
+ * so solve the 2x2 normal equations per channel. Returns false if the indices don't pin the ends down (all the same).
+ */
+inline bool bc1RefitEndpoints(const unsigned char block[16][4], const int indices[16], float start[3], float end[3])
+{
+    const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float a = weights[indices[i]], b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < 3; c++)
+        {
+            ax[c] += a * block[i][c];
+            bx[c] += b * block[i][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+    {
+        return false;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        start[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+        end[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+// Writes the 8 byte color part, always in 4 color mode (which is also what BC3 requires).
+inline void encodeBC1Color(const unsigned char block[16][4], unsigned char out[8])
+{
+    float points[16][4];
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            points[i][c] = block[i][c];
+        }
+    }
+    float start[4], end[4];
+    compressionEndpoints(points, 3, start, end);
+
+    unsigned short color0 = packColor565(start), color1 = packColor565(end);
+    int indices[16];
+    int error = bc1PickIndices(block, color0, color1, indices);
+
+    float refitStart[3], refitEnd[3];
+    if (error > 0 && bc1RefitEndpoints(block, indices, refitStart, refitEnd))
+    {
+        unsigned short refit0 = packColor565(refitStart), refit1 = packColor565(refitEnd);
+        int refitIndices[16];
+        int refitError = bc1PickIndices(block, refit0, refit1, refitIndices);
+        if (refitError < error)
+        {
+            color0 = refit0;
+            color1 = refit1;
+            std::memcpy(indices, refitIndices, sizeof(indices));
+        }
+    }
+
+    // 4 color mode needs color0 > color1. Swapping the ends means swapping what the indices point at too.
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+        const int swapped[4] = {1, 0, 3, 2};
+        for (int i = 0; i < 16; i++)
+        {
+            indices[i] = swapped[indices[i]];
+        }
+    }
+    else if (color0 == color1)
+    {
+        // Every index decodes to the same color anyway, and 0 means the same thing in both modes
+        std::memset(indices, 0, sizeof(indices));
+    }
+
+    std::uint32_t bits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        bits |= (std::uint32_t)indices[i] << (2 * i);
+    }
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++)
+    {
+        out[4 + i] = (bits >> (8 * i)) & 0xFF;
+    }
+}
+
+inline void decodeBC1Color(const unsigned char in[8], bool allowThreeColor, unsigned char out[16][4])
+{
+    unsigned short color0 = in[0] | (in[1] << 8), color1 = in[2] | (in[3] << 8);
+    int palette[4][4];
+    bc1Palette(color0, color1, !allowThreeColor || color0 > color1, palette);
+    std::uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((std::uint32_t)in[7] << 24);
+    for (int i = 0; i < 16; i++)
+    {
+        const int* color = palette[(bits >> (2 * i)) & 3];
+        for (int c = 0; c < 4; c++)
+        {
+            out[i][c] = (unsigned char)color[c];
+        }
+    }
+}
+
+// -- BC3 alpha block --
+
+inline void alphaPalette(int alpha0, int alpha1, int palette[8])
+{
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    for (int i = 1; i < 7; i++)
+    {
+        palette[i + 1] = alpha0 > alpha1 ? ((7 - i) * alpha0 + i * alpha1) / 7 : (i < 5 ? ((5 - i) * alpha0 + i * alpha1) / 5 : (i == 5 ? 0 : 255));
+    }
+}
+
+inline void encodeBC3Alpha(const unsigned char block[16][4], unsigned char out[8])
+{
+    int high = 0, low = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        high = std::max(high, (int)block[i][3]);
+        low = std::min(low, (int)block[i][3]);
+    }
+    out[0] = (unsigned char)high;
+    out[1] = (unsigned char)low;
+    std::uint64_t bits = 0;
+    if (high != low)
+    {
+        int palette[8];
+        alphaPalette(high, low, palette);
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < 8; p++)
+            {
+                int error = std::abs(block[i][3] - palette[p]);
+                if (error < bestError)
+                {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            bits |= (std::uint64_t)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+    {
+        out[2 + i] = (bits >> (8 * i)) & 0xFF;
+    }
+}
+
+inline void decodeBC3Alpha(const unsigned char in[8], unsigned char out[16][4])
+{
+    int palette[8];
+    alphaPalette(in[0], in[1], palette);
+    std::uint64_t bits = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        bits |= (std::uint64_t)in[2 + i] << (8 * i);
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        out[i][3] = (unsigned char)palette[(bits >> (3 * i)) & 7];
+    }
+}
+
+// -- BC7 mode 6 --
+
+const int BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BC7Bits
+{
+    std::uint64_t word[2] = {0, 0};
+    int position = 0;
+
+    void write(std::uint32_t value, int count)
+    {
+        for (int i = 0; i < count; i++, position++)
+        {
+            word[position / 64] |= (std::uint64_t)((value >> i) & 1) << (position % 64);
+        }
+    }
+
+    std::uint32_t read(int count)
+    {
+        std::uint32_t value = 0;
+        for (int i = 0; i < count; i++, position++)
+        {
+            value |= (std::uint32_t)((word[position / 64] >> (position % 64)) & 1) << i;
+        }
+        return value;
+    }
+};
+
+inline void encodeBC7Mode6(const unsigned char block[16][4], unsigned char out[16])
+{
+    float points[16][4];
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            points[i][c] = block[i][c];
+        }
+    }
+    float start[4], end[4];
+    compressionEndpoints(points, 4, start, end);
+
+    // Endpoints are 7 bits per channel plus one shared low bit (the p-bit) per endpoint. Try all four p-bit pairs.
+    int bestError = 1 << 30, bestIndices[16] = {};
+    int bestEnds[2][4] = {}, bestP[2] = {};
+    for (int p0 = 0; p0 < 2; p0++)
+    {
+        for (int p1 = 0; p1 < 2; p1++)
+        {
+            int ends[2][4], color[2][4];
+            for (int c = 0; c < 4; c++)
+            {
+                ends[0][c] = std::min(std::max((int)((start[c] - p0) / 2.0f + 0.5f), 0), 127);
+                ends[1][c] = std::min(std::max((int)((end[c] - p1) / 2.0f + 0.5f), 0), 127);
+                color[0][c] = (ends[0][c] << 1) | p0;
+                color[1][c] = (ends[1][c] << 1) | p1;
+            }
+            int palette[16][4];
+            for (int w = 0; w < 16; w++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    palette[w][c] = ((64 - BC7_WEIGHTS4[w]) * color[0][c] + BC7_WEIGHTS4[w] * color[1][c] + 32) >> 6;
+                }
+            }
+            int error = 0, indices[16];
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestTexel = 1 << 30;
+                for (int w = 0; w < 16; w++)
+                {
+                    int texelError = 0;
+                    for (int c = 0; c < 4; c++)
+                    {
+                        int d = block[i][c] - palette[w][c];
+                        texelError += d * d;
+                    }
+                    if (texelError < bestTexel)
+                    {
+                        best = w;
+                        bestTexel = texelError;
+                    }
+                }
+                indices[i] = best;
+                error += bestTexel;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                std::memcpy(bestIndices, indices, sizeof(indices));
+                std::memcpy(bestEnds, ends, sizeof(ends));
+                bestP[0] = p0;
+                bestP[1] = p1;
+            }
+        }
+    }
+
+    // The first index is stored with 3 bits, its top bit is assumed 0. If it isn't, flip the line around.
+    if (bestIndices[0] & 8)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            std::swap(bestEnds[0][c], bestEnds[1][c]);
+        }
+        std::swap(bestP[0], bestP[1]);
+        for (int i = 0; i < 16; i++)
+        {
+            bestIndices[i] = 15 - bestIndices[i];
+        }
+    }
+
+    BC7Bits bits;
+    bits.write(1 << 6, 7); // Mode 6 = six 0 bits then a 1
+    for (int c = 0; c < 4; c++)
+    {
+        bits.write(bestEnds[0][c], 7);
+        bits.write(bestEnds[1][c], 7);
+    }
+    bits.write(bestP[0], 1);
+    bits.write(bestP[1], 1);
+    bits.write(bestIndices[0], 3);
+    for (int i = 1; i < 16; i++)
+    {
+        bits.write(bestIndices[i], 4);
+    }
+    std::memcpy(out, bits.word, 16);
+}
+
+// Mode 6 only. Anything else decodes as magenta so it's obvious.
+inline void decodeBC7(const unsigned char in[16], unsigned char out[16][4])
+{
+    BC7Bits bits;
+    std::memcpy(bits.word, in, 16);
+    if (bits.read(7) != (1 << 6))
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            out[i][0] = 255; out[i][1] = 0; out[i][2] = 255; out[i][3] = 255;
+        }
+        return;
+    }
+    int ends[2][4];
+    for (int c = 0; c < 4; c++)
+    {
+        ends[0][c] = bits.read(7);
+        ends[1][c] = bits.read(7);
+    }
+    int p0 = bits.read(1), p1 = bits.read(1);
+    for (int c = 0; c < 4; c++)
+    {
+        ends[0][c] = (ends[0][c] << 1) | p0;
+        ends[1][c] = (ends[1][c] << 1) | p1;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        int w = BC7_WEIGHTS4[bits.read(i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++)
+        {
+            out[i][c] = (unsigned char)(((64 - w) * ends[0][c] + w * ends[1][c] + 32) >> 6);
+        }
+    }
+}
+
+// -- Whole images --
+
+// Runs work(begin, end) over [0, rows) block rows, split across threads when there's enough of them.
+template <typename Work>
+void compressionParallelRows(int rows, int threads, const Work &work)
+{
+    threads = std::min(threads > 0 ? threads : (int)std::thread::hardware_concurrency(), rows / 8);
+    if (threads <= 1)
+    {
+        work(0, rows);
+        return;
+    }
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++)
+    {
+        pool.push_back(std::thread(work, rows * i / threads, rows * (i + 1) / threads));
+    }
+    work(0, rows / threads);
+    for (std::thread &thread : pool)
+    {
+        thread.join();
+    }
+}
+
+// 8 bit pixels with 1-4 channels in, blocks out (compressedTextureBytes of them). Missing channels count as opaque/grey.
+inline std::vector<unsigned char> compressTexture(const unsigned char* pixels, int width, int height, int channels, TextureCompression compression, int threads = 0)
+{
+    std::vector<unsigned char> blocks(compressedTextureBytes(compression, width, height));
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4, blockBytes = compressedBlockBytes(compression);
+    compressionParallelRows(blocksHigh, threads, [&](int begin, int end)
+    {
+        unsigned char block[16][4];
+        for (int by = begin; by < end; by++)
+        {
+            for (int bx = 0; bx < blocksWide; bx++)
+            {
+                unsigned char* out = &blocks[((std::size_t)by * blocksWide + bx) * blockBytes];
+                loadCompressionBlock(pixels, width, height, channels, bx, by, block);
+                if (compression == TEXTURE_BC1)
+                {
+                    encodeBC1Color(block, out);
+                }
+                else if (compression == TEXTURE_BC3)
+                {
+                    encodeBC3Alpha(block, out);
+                    encodeBC1Color(block, out + 8);
+                }
+                else
+                {
+                    encodeBC7Mode6(block, out);
+                }
+            }
+        }
+    });
+    return blocks;
+}
+
+// Blocks in, width * height RGBA texels out
+inline void decompressTexture(const unsigned char* blocks, int width, int height, TextureCompression compression, unsigned char* rgba)
+{
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4, blockBytes = compressedBlockBytes(compression);
+    unsigned char block[16][4];
+    for (int by = 0; by < blocksHigh; by++)
+    {
+        for (int bx = 0; bx < blocksWide; bx++)
+        {
+            const unsigned char* in = blocks + ((std::size_t)by * blocksWide + bx) * blockBytes;
+            if (compression == TEXTURE_BC1)
+            {
+                decodeBC1Color(in, true, block);
+            }
+            else if (compression == TEXTURE_BC3)
+            {
+                decodeBC1Color(in + 8, false, block);
+                decodeBC3Alpha(in, block);
+            }
+            else
+            {
+                decodeBC7(in, block);
+            }
+            for (int y = 0; y < 4 && by * 4 + y < height; y++)
+            {
+                for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+                {
+                    std::memcpy(rgba + ((std::size_t)(by * 4 + y) * width + bx * 4 + x) * 4, block[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef TEXTURE_FORMAT_H
+#define TEXTURE_FORMAT_H
+
+#include <glad/glad.h>
+
+#include "texture_compression.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/**
+ * -- Baked Textures (.baked) --
+ * A tiny KTX-like container written by bake_textures.cpp ahead of time, so the lesson never decodes a jpg/png:
+ * the pixels are already in the GL format they get uploaded in, already flipped for OpenGL, with every mip level
+ * already made. Loading one is mmap + one glTexImage2D per level (see loadBakedTexture in texture_streamer.h).
+ *
+ * Layout (all little endian, like the machine that wrote it):
+ *     BakedTextureHeader
+ *     BakedTextureLevel[levels]   Level 0 first
+ *     pixel data                  Each level starts on a 16 byte boundary, rows tightly packed (unpack alignment 1)
+ *
+ * If `compression` isn't 0 the levels hold BC blocks (texture_compression.h) instead of texels, and internalFormat
+ * is the matching GL_COMPRESSED_* enum.
+ */
+
+// Block compressed formats, from EXT_texture_compression_s3tc & ARB_texture_compression_bptc. Not in our 3.3 glad.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+inline GLenum compressedGLFormat(TextureCompression compression)
+{
+    switch (compression)
+    {
+    case TEXTURE_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TEXTURE_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return 0;
+    }
+}
+
+const char BAKED_TEXTURE_MAGIC[8] = {'L', 'O', 'G', 'L', 'T', 'X', '1', '\0'};
+
+struct BakedTextureHeader
+{
+    char magic[8];
+    std::uint32_t format;         // glTexImage2D format, GL_RED/GL_RG/GL_RGB/GL_RGBA
+    std::uint32_t internalFormat; // glTexImage2D internal format
+    std::uint32_t type;           // Always GL_UNSIGNED_BYTE for now
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t levels;
+    std::uint32_t channels;
+    std::uint32_t compression;    // TextureCompression, 0 = plain texels
+};
+
+struct BakedTextureLevel
+{
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint64_t offset; // From the start of the file
+    std::uint64_t size;
+};
+
+static_assert(sizeof(BakedTextureHeader) == 40 && sizeof(BakedTextureLevel) == 24, "baked texture structs are written to disk as is");
+
+// Where pixel data can start after the header & level table
+inline std::uint64_t bakedTextureDataStart(std::uint32_t levels)
+{
+    std::uint64_t end = sizeof(BakedTextureHeader) + levels * sizeof(BakedTextureLevel);
+    return (end + 15) / 16 * 16;
+}
+
+/**
+ * Checks a whole file (as bytes) is a baked texture whose levels all fit inside it, with 1-4 channels and each level
+ * half the size of the one before (like GL's mip chain, down to 1). Anything that fails this is treated as not a baked
+ * texture at all, never half-uploaded.
+ */
+inline bool validBakedTexture(const unsigned char* data, std::size_t size)
+{
+    if (size < sizeof(BakedTextureHeader))
+    {
+        return false;
+    }
+    BakedTextureHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, BAKED_TEXTURE_MAGIC, sizeof(header.magic)) != 0 || header.levels == 0 || header.levels > 32 || header.type != GL_UNSIGNED_BYTE
+        || (header.compression != TEXTURE_UNCOMPRESSED && header.compression != TEXTURE_BC1 && header.compression != TEXTURE_BC3 && header.compression != TEXTURE_BC7)
+        || header.channels < 1 || header.channels > 4 || header.width == 0 || header.height == 0)
+    {
+        return false;
+    }
+    if (bakedTextureDataStart(header.levels) > size)
+    {
+        return false;
+    }
+    for (std::uint32_t i = 0; i < header.levels; i++)
+    {
+        BakedTextureLevel level;
+        std::memcpy(&level, data + sizeof(BakedTextureHeader) + i * sizeof(BakedTextureLevel), sizeof(level));
+        std::uint32_t width = header.width >> i, height = header.height >> i;
+        if (level.width != (width > 0 ? width : 1) || level.height != (height > 0 ? height : 1))
+        {
+            return false;
+        }
+        std::uint64_t expected = header.compression != TEXTURE_UNCOMPRESSED
+            ? compressedTextureBytes((TextureCompression)header.compression, level.width, level.height)
+            : (std::uint64_t)level.width * level.height * header.channels;
+        if (level.offset > size || level.size > size - level.offset || level.size != expected)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
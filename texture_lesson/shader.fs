@@ -4,11 +4,23 @@ in vec3 color;
 in vec2 texCoord;
 
 out vec4 FragColor;
-uniform sampler2D ourTexture; //the texture reference
-uniform sampler2D otherTexture;
+#ifdef BAKED
+// The `make bake` versions, each its own 2D texture (see textures.cpp)
+uniform sampler2D ourTexture; // container
+uniform sampler2D otherTexture; // awesomeface
+#else
+// Both images are layers of one texture array (texture_packer.h), so drawing needs a single bind
+uniform sampler2DArray textures;
+uniform int ourLayer; // container
+uniform int otherLayer; // awesomeface
+#endif
 
 void main()
 {
     // mix -> linearly interpolate between two values. 0.2 returns 80% of first value and 20% of the sescond value.
+#ifdef BAKED
     FragColor = mix(texture(ourTexture, texCoord), texture(otherTexture, texCoord), 0.2);
+#else
+    FragColor = mix(texture(textures, vec3(texCoord, ourLayer)), texture(textures, vec3(texCoord, otherLayer)), 0.2);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec3 color;
+in vec2 texCoord;
+
+out vec4 FragColor;
+// A plain 2D texture that TextureStreamer loads in the background, smallest mip level first (see textures.cpp)
+uniform sampler2D wall;
+
+void main()
+{
+    FragColor = texture(wall, texCoord);
+}
@@ -1,13 +1,22 @@
+#include "../stbi_arena.h" // stb_image allocates from per-thread arenas, has to come before stb_image.h
 #define STB_IMAGE_IMPLEMENTATION
 #include "../stb_image.h" // Image Loader
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "shader.h"
+#include "../shader_lesson/shader_variants.h"
+#include "../frame_uniforms.h"
+#include "texture_bindings.h" // Generated from the shaders by the Makefile, see reflect_shaders.cpp
+#include "../shader_watcher.h"
+#include "../texture_packer.h"
+#include "../sampler_cache.h"
+#include "../texture_cache.h"
 
 
 #include <iostream>
 #include <cmath>
+#include <unistd.h>
 
 void framebuffer_size_callback(GLFWwindow*, int, int);
 void processInput(GLFWwindow*);
@@ -47,13 +56,22 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // Anything past GL 3.3 that glad doesn't load for us (program binaries, etc). See gl_extensions.h
+    loadGLExtensions((GLADloadproc) glfwGetProcAddress);
 
     glViewport(0, 0, 800, 600);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
 
+    // Whether `make bake` has been run. Then the images load from the .baked files, with nothing to decode (see below).
+    const bool baked = access("texture_lesson/container.baked", R_OK) == 0 && access("texture_lesson/awesomeface.baked", R_OK) == 0;
+
     // Using the Shader we created! Handles all the compiling, linking, etc.
-    Shader shaderProgram = Shader("texture_lesson/shader.vs", "texture_lesson/shader.fs");
+    // basic.vs is shared by every lesson, TEXCOORD switches on the texture coordinate attribute.
+    // The OFFSET variant of the same pair (holding O slides the quad) only gets compiled the first time it's used.
+    ShaderVariants texturedQuad("shader_lesson/basic.vs", "texture_lesson/shader.fs", {"TEXCOORD", "OFFSET", "PULSE", "BAKED"});
+    const std::uint32_t baseVariant = texturedQuad.bit("TEXCOORD") | (baked ? texturedQuad.bit("BAKED") : 0);
+    Shader &shaderProgram = texturedQuad.get(baseVariant);
 
     unsigned int VBO, VAO, EBO;
     glGenBuffers(1, &VBO);
@@ -69,13 +87,16 @@ int main()
 
     // Vertex Attribute for Positions & Colors & Texture Coords respectively
     // index, indices, type, normalized?, size of entire thing, start of attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-
-    glEnableVertexAttribArray(0); 
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
+    // The numbers come from texture_bindings.h, generated from the shaders. A mismatch with vertices[] fails the build.
+    static_assert(TextureBindings::componentsPerVertex == 8, "vertices[] has 8 floats per vertex");
+    const int stride = TextureBindings::componentsPerVertex * sizeof(float);
+    glVertexAttribPointer(TextureBindings::aPos.location, TextureBindings::aPos.components, GL_FLOAT, GL_FALSE, stride, (void*)(TextureBindings::aPos.offset * sizeof(float)));
+    glVertexAttribPointer(TextureBindings::aColor.location, TextureBindings::aColor.components, GL_FLOAT, GL_FALSE, stride, (void*)(TextureBindings::aColor.offset * sizeof(float)));
+    glVertexAttribPointer(TextureBindings::aTexCoord.location, TextureBindings::aTexCoord.components, GL_FLOAT, GL_FALSE, stride, (void*)(TextureBindings::aTexCoord.offset * sizeof(float)));
+
+    glEnableVertexAttribArray(TextureBindings::aPos.location); 
+    glEnableVertexAttribArray(TextureBindings::aColor.location);
+    glEnableVertexAttribArray(TextureBindings::aTexCoord.location);
     
     /**
      * glTexParameteri
@@ -85,9 +106,14 @@ int main()
      * 
      * Clamp to edge - Whatever color the edge is, it extends infinitely
      * Clamp to border - any outside pixel will be some border color set. Note you'll add a border color argument to the end which will be a float[].
+     *
+     * These used to be glTexParameteri calls right here, before any texture was bound, so they never reached a texture
+     * at all! Now they go in a sampler object (sampler_cache.h), which is bound to the texture unit & overrides whatever
+     * the texture itself says. Same parameter names, just set once on the sampler.
      */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+    SamplerParams smooth;
+    smooth.wrapS = GL_MIRRORED_REPEAT;
+    smooth.wrapT = GL_MIRRORED_REPEAT;
 
     /**
      * -- Texture Filtering --
@@ -96,8 +122,7 @@ int main()
      * Linear - interpolates between colors when its not centered on a pixel color
      * Min/Mag - Which options above you'd like to choose when the texture is upscaled or downscaled
      */
-    //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    smooth.magFilter = GL_LINEAR;
 
 
     /**
@@ -108,16 +133,11 @@ int main()
      * Linear - interpolates between mipmap levels
      * Make sure to create the mipmap texture after loading the texture with `glGenerateMipmap`
      */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR); // Linear Mipmap, nearest texture!
-
-    // Loading image with stb_images
-    int width, height, nrChannels; // nrChannels = # of color channels
-    unsigned char *data = stbi_load("texture_lesson/container.jpg", &width, &height, &nrChannels, 0);
-    
-    // Texture Object 
-    unsigned int texture, texture1;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    smooth.minFilter = GL_NEAREST_MIPMAP_LINEAR; // Linear Mipmap, nearest texture!
+    // Hold N to see the 8 bit art look. Switching is one glBindSampler, not a round of glTexParameteri on every texture.
+    SamplerParams pixelated = smooth;
+    pixelated.magFilter = GL_NEAREST;
+    SamplerCache samplers;
 
     /**
      * glTexImage2D
@@ -128,48 +148,117 @@ int main()
      * 6. Always 0. Legacy stuff
      * 7 & 8. Format & Datatype of original source image. Char = Byte
      * 9. Actual image data
+     *
+     * Used to be stbi_load + glTexImage2D right here, once per texture, and then two glBindTexture calls every frame.
+     * Now both images go into one GL_TEXTURE_2D_ARRAY (texture_packer.h), a layer each. They're both 512x512 & the
+     * packer decodes them to RGBA, so they fit in the same array. One bind covers both, and a scene with lots of
+     * differently textured quads could draw them all at once, each picking its layer.
+     * Flipped, since OpenGL expects (0,0) to be on the bottom but for jpgs & pngs it's at the top!
+     *
+     * After `make bake` there's no decoding at all: the .baked files are already flipped, mipmapped & block compressed,
+     * so TextureCache hands them to TextureStreamer, which maps each one & uploads its levels as they are
+     * (loadBakedTexture). One is BC1 & the other BC7, which can't share an array, so they're two plain 2D textures
+     * then & the BAKED variant of shader.fs samples them. The packer is only the fallback for when they aren't there.
      */
-    if (data) 
+    TextureStreamer streamer;
+    TextureCache textureCache(streamer);
+    const int containerUnit = 0, faceUnit = 1;
+    TextureRef bakedContainer, bakedFace;
+    TexturePacker packer(TEXTURE_PACK_ARRAY);
+    int container = -1, face = -1;
+    double loadStart = glfwGetTime();
+    if (baked)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        bakedContainer = textureCache.get("texture_lesson/container.baked");
+        bakedFace = textureCache.get("texture_lesson/awesomeface.baked");
+        std::cout << "TEXTURE::BAKED::DONE in " << (glfwGetTime() - loadStart) * 1000.0 << "ms" << std::endl;
     }
-    else 
+    else
     {
-        std::cout << "Failed to load texture." << std::endl;
+        container = packer.add("texture_lesson/container.jpg", true);
+        face = packer.add("texture_lesson/awesomeface.png", true);
+        packer.build();
+        std::cout << "TEXTURE::PACKER::DONE " << packer.pages().size() << " page(s) in " << (glfwGetTime() - loadStart) * 1000.0 << "ms" << std::endl;
     }
-    stbi_image_free(data); // After creating texture & mipmaps, free image memory
 
-    // Load second texture. Repeat steps above.
-    // --------------------------------
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
+    // Per-frame data for every program, one upload a frame (see frame_uniforms.h)
+    UniformBuffer<FrameUniforms> frameUniforms(FRAME_UNIFORMS_BINDING, 3);
+    FrameUniforms frameData;
 
-    stbi_set_flip_vertically_on_load(true); // OpenGL expects (0,0) to be on the bottom, but for pngs it's at the top!
-    data = stbi_load("texture_lesson/awesomeface.png", &width, &height, &nrChannels, 0);
-    if (data) 
-    {
-        // Since we are using a png, we need to specify an alpha channel. (7th argument)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else 
+    // Each variant is its own program, so each one needs its uniforms set once
+    auto setUpProgram = [&](Shader &program)
     {
-        std::cout << "Failed to load awesomeface.png texture" << std::endl;
-    }
-    stbi_image_free(data); // After creating texture & mipmaps, free image memory
+        program.use();
+        /**
+         * Tells which texture unit we will use for shader sample.
+         * Used to be glUniform1i(glGetUniformLocation(shaderProgram.ID, "ourTexture"), 0) & shaderProgram.setInt("otherTexture", 1),
+         * now the units are picked by the generated bindings, in the order the samplers are declared.
+         * The bindings are generated from the array version, so the BAKED one's samplers are set by name.
+         */
+        if (baked)
+        {
+            program.setInt("ourTexture"_u, containerUnit);
+            program.setInt("otherTexture"_u, faceUnit);
+        }
+        else
+        {
+            TextureBindings::bindSamplers(program);
+            TextureBindings::setOurLayer(program, packer.image(container).layer);
+            TextureBindings::setOtherLayer(program, packer.image(face).layer);
+        }
+        program.bindUniformBlock(frameUniforms);
+    };
+    setUpProgram(shaderProgram);
 
-    shaderProgram.use();
     /**
-     * Two different ways of setting the texture values within the fragment shader.
-     * Tells which texture unit we will use for shader sample
+     * Hold W to see wall.jpg instead. It isn't packed with the others: TextureCache loads it through TextureStreamer,
+     * so the worker threads decode it while we're already drawing, and it gets sharper a mip level at a time as
+     * update() uploads them. Straight after launch you can watch it go from grey to blurry to sharp.
+     * Unless it's been baked, then it's all there on the first frame.
      */
-    glUniform1i(glGetUniformLocation(shaderProgram.ID, "ourTexture"), 0);
-    shaderProgram.setInt("otherTexture", 1);
+    const char* wallPath = access("texture_lesson/wall.baked", R_OK) == 0 ? "texture_lesson/wall.baked" : "texture_lesson/wall.jpg";
+    TextureRef wall = textureCache.get(wallPath, true);
+    const int wallUnit = 2; // Units 0 & 1 have the other two images
+    Shader wallProgram("shader_lesson/basic.vs", "texture_lesson/streamed.fs", {"TEXCOORD"});
+    wallProgram.use();
+    wallProgram.setInt("wall"_u, wallUnit);
+    wallProgram.bindUniformBlock(frameUniforms);
+
+    // Edit texture_lesson/shader.fs (or shader_lesson/basic.vs & the vertex_inputs.glsl it includes) while this is running & it gets swapped in without restarting. See shader_watcher.h
+    ShaderWatcher watcher;
+    int watchID = watcher.watch("shader_lesson/basic.vs", "texture_lesson/shader.fs", shaderProgram.includes());
+    std::string newVertexCode, newFragmentCode;
+    std::vector<ShaderFile> newIncludedFiles;
+    // Frame times so we can see whether a reload causes a hitch. averageFrame is a running average.
+    double lastFrame = glfwGetTime(), averageFrame = 0.0;
+    bool reloadedLastFrame = false;
+    unsigned int frameCount = 0;
 
     while (!glfwWindowShouldClose(window)) 
     {
+        double now = glfwGetTime();
+        double frameTime = now - lastFrame;
+        lastFrame = now;
+        if (reloadedLastFrame)
+        {
+            std::cout << "SHADER::RELOAD frame took " << frameTime * 1000.0 << "ms (average " << averageFrame * 1000.0 << "ms)" << std::endl;
+            reloadedLastFrame = false;
+        }
+        else
+        {
+            averageFrame = averageFrame == 0.0 ? frameTime : averageFrame * 0.95 + frameTime * 0.05;
+        }
+
+        // Between frames is the only safe spot to swap programs
+        if (watcher.takeChanged(watchID, newVertexCode, newFragmentCode, newIncludedFiles))
+        {
+            shaderProgram.reload(newVertexCode, newFragmentCode, &newIncludedFiles);
+            reloadedLastFrame = true;
+        }
+
         processInput(window);
+        frameData.time = (float)glfwGetTime();
+        frameUniforms.update(frameData);
 
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -187,11 +276,58 @@ int main()
         /**
          * Here we are binding texture units so we can use multiple textures within our fragment shader
          * Make sure to tell OpenGL which texture unit belongs to which shader sample  
+         * Both textures are in the same array (same page), so that's one bind now instead of one per texture. Baked, they're two.
          */
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture1);
+        const SamplerParams &filtering = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS ? pixelated : smooth;
+        if (baked)
+        {
+            textureCache.bind(bakedContainer, containerUnit);
+            textureCache.bind(bakedFace, faceUnit);
+            samplers.bind(containerUnit, filtering);
+            samplers.bind(faceUnit, filtering);
+        }
+        else
+        {
+            packer.bind(packer.image(container).page, TextureBindings::texturesUnit);
+            samplers.bind(TextureBindings::texturesUnit, filtering);
+        }
+
+        // A few MB of the wall's mips per frame, then the cache checks its VRAM budget
+        streamer.update();
+        textureCache.update();
+
+        // Hold O to slide the quad back & forth with the OFFSET variant, P to pulse its colors with the PULSE one (or both)
+        Shader* program = &shaderProgram;
+        std::uint32_t variant = baseVariant;
+        if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS)
+        {
+            variant |= texturedQuad.bit("OFFSET");
+        }
+        if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+        {
+            variant |= texturedQuad.bit("PULSE");
+        }
+        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        {
+            textureCache.bind(wall, wallUnit);
+            samplers.bind(wallUnit, smooth);
+            program = &wallProgram;
+        }
+        else
+        {
+            int compiled = texturedQuad.compiledCount();
+            program = &texturedQuad.get(variant);
+            if (texturedQuad.compiledCount() != compiled)
+            {
+                setUpProgram(*program);
+            }
+        }
+        program->use();
+        // After use(), set() writes to whichever program is bound
+        if (program != &wallProgram && (variant & texturedQuad.bit("OFFSET")))
+        {
+            program->set("offset"_u, 0.5f * (float)sin(now));
+        }
 
         glBindVertexArray(VAO); 
         //glDrawArrays(GL_TRIANGLES, 0, 3); 
@@ -199,6 +335,13 @@ int main()
         
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        // How many glUniform calls the shadow copies saved, every 600 frames (10 seconds at 60fps)
+        uniformStats.endFrame();
+        if (++frameCount % 600 == 0)
+        {
+            uniformStats.print();
+        }
     }
 
     glfwTerminate();
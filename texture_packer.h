@@ -0,0 +1,342 @@
+#ifndef TEXTURE_PACKER_H
+#define TEXTURE_PACKER_H
+
+#include <glad/glad.h>
+
+#include "mip_generator.h"
+#include "texture_upload.h"
+#include "texture_streamer.h" // image_loader.h for decoding
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+/**
+ * -- Texture Packing --
+ * Every glBindTexture between draws is a state change, so a scene of sprites that each have their own texture binds
+ * once per draw, and can't put two differently textured quads in the same draw call. Packing images into one
+ * texture fixes both: bind it once, and every quad just needs to know where its image is inside it. Two ways:
+ *   Array - a GL_TEXTURE_2D_ARRAY, one image per layer. Images of the same size & format share an array, so a
+ *           group of different sizes makes one array per size. Full mip chain, wrapping still works.
+ *           Sample with texture(sampler2DArray, vec3(uv, layer)).
+ *   Atlas - a GL_TEXTURE_2D with the images packed side by side in rows ("shelves"), any sizes. Each image gets a
+ *           gutter of its own edge pixels around it, and starts on a multiple of 2^levels, so a mip texel never
+ *           mixes two images. That only holds while the gutter is still at least a texel wide, so an atlas has
+ *           log2(gutter) mips below the base (gutter 8 => 3) & clamps instead of wrapping.
+ *
+ * Either way every image comes back with its page (which texture), its layer (always 0 in an atlas) and a
+ * scale/offset for its UVs:  uv' = uv * uvScale + uvOffset
+ *
+ * `channels` converts everything to that many channels when decoding (like stbi_load's last argument), so e.g. RGB
+ * jpgs & RGBA pngs can end up in the same page. 0 keeps what each file has, which splits them up by channel count.
+ *
+ * Usage:
+ *     TexturePacker packer(TEXTURE_PACK_ARRAY);
+ *     int box = packer.add("texture_lesson/container.jpg", true);
+ *     int face = packer.add("texture_lesson/awesomeface.png", true);
+ *     packer.build(); // Decodes on all cores (loadImages), packs & uploads
+ *     const PackedImage &image = packer.image(face);
+ *     packer.bind(image.page, 0); // Then draw with image.layer, image.uvScale & image.uvOffset
+ */
+
+enum TexturePackMode
+{
+    TEXTURE_PACK_ARRAY,
+    TEXTURE_PACK_ATLAS
+};
+
+struct PackedImage
+{
+    int page = -1; // Index into pages(), -1 if the image failed to load or didn't fit
+    int layer = 0;
+    float uvScale[2] = {1.0f, 1.0f};
+    float uvOffset[2] = {0.0f, 0.0f};
+    int width = 0;
+    int height = 0;
+};
+
+struct TexturePage
+{
+    unsigned int ID;
+    GLenum target; // GL_TEXTURE_2D_ARRAY or GL_TEXTURE_2D
+    int width;
+    int height;
+    int layers;
+    int channels;
+    int levels; // Mip levels incl. the base
+};
+
+class TexturePacker
+{
+public:
+    /**
+     * `maxSize` is the biggest an atlas page gets (width & height) before a new page is started.
+     * `gutter` is the border of edge pixels around each atlas image, a power of two.
+     */
+    TexturePacker(TexturePackMode mode = TEXTURE_PACK_ARRAY, int channels = 4, int maxSize = 4096, int gutter = 8);
+
+    // Queues an image, returns its handle for image(). `flip` is for images stored top row first (png, jpg).
+    int add(const std::string &path, bool flip = false);
+
+    // Decodes everything added so far, packs it & uploads the pages. Returns false if any image failed.
+    bool build();
+
+    const PackedImage& image(int handle) const { return images[handle]; }
+    const std::vector<TexturePage>& pages() const { return pageList; }
+
+    // glActiveTexture + glBindTexture with the page's target
+    void bind(int page, int unit) const;
+
+private:
+    TexturePackMode mode;
+    int channels;
+    int maxSize;
+    int gutter;
+    std::vector<ImageRequest> requests;
+    std::vector<PackedImage> images;
+    std::vector<TexturePage> pageList;
+    std::size_t built = 0; // Images already packed by an earlier build()
+
+    void buildArrays(const std::vector<LoadedImage> &loaded, const std::vector<int> &handles);
+    void buildAtlases(const std::vector<LoadedImage> &loaded, const std::vector<int> &handles);
+    void uploadAtlas(TexturePage &page, const std::vector<unsigned char> &pixels);
+};
+
+inline TexturePacker::TexturePacker(TexturePackMode mode, int channels, int maxSize, int gutter) : mode(mode), channels(channels), maxSize(maxSize), gutter(gutter)
+{
+}
+
+inline int TexturePacker::add(const std::string &path, bool flip)
+{
+    ImageRequest request;
+    request.path = path;
+    request.flip = flip;
+    request.channels = channels;
+    request.expandRGB = chooseTextureFormat(3, MIP_UNORM8).decodeChannels == 4;
+    requests.push_back(request);
+    images.push_back(PackedImage());
+    return (int)images.size() - 1;
+}
+
+inline bool TexturePacker::build()
+{
+    // Only the images added since the last build
+    std::size_t first = built;
+    built = images.size();
+    std::vector<LoadedImage> loaded = loadImages(requests.data() + first, requests.size() - first);
+    std::vector<int> handles;
+    bool ok = true;
+    for (std::size_t i = 0; i < loaded.size(); i++)
+    {
+        if (loaded[i].pixels)
+        {
+            handles.push_back((int)(first + i));
+        }
+        else
+        {
+            ok = false; // loadImage already said why
+        }
+    }
+
+    // Same channel count next to each other (and same size for arrays), biggest first, which packs shelves tighter
+    std::sort(handles.begin(), handles.end(), [&](int a, int b)
+    {
+        const LoadedImage &x = loaded[a - first], &y = loaded[b - first];
+        if (x.channels != y.channels) return x.channels < y.channels;
+        if (x.height != y.height) return x.height > y.height;
+        return x.width > y.width;
+    });
+    std::vector<LoadedImage> sorted;
+    for (int &handle : handles)
+    {
+        sorted.push_back(std::move(loaded[handle - first]));
+        images[handle].width = sorted.back().width;
+        images[handle].height = sorted.back().height;
+    }
+
+    // Rows aren't a multiple of 4 bytes for every width & channel count
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (mode == TEXTURE_PACK_ARRAY)
+    {
+        buildArrays(sorted, handles);
+    }
+    else
+    {
+        buildAtlases(sorted, handles);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return ok;
+}
+
+inline void TexturePacker::buildArrays(const std::vector<LoadedImage> &loaded, const std::vector<int> &handles)
+{
+    int maxLayers = 256; // What GL 3.3 promises at least
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    for (std::size_t start = 0; start < loaded.size(); )
+    {
+        // A run of images with the same size & channels, up to maxLayers of them
+        const LoadedImage &base = loaded[start];
+        std::size_t end = start + 1;
+        while (end < loaded.size() && (int)(end - start) < maxLayers && loaded[end].width == base.width && loaded[end].height == base.height && loaded[end].channels == base.channels)
+        {
+            end++;
+        }
+
+        TexturePage page{0, GL_TEXTURE_2D_ARRAY, base.width, base.height, (int)(end - start), base.channels, textureMipLevels(base.width, base.height)};
+        TextureUploadFormat upload = chooseTextureFormat(base.channels, MIP_UNORM8);
+        glGenTextures(1, &page.ID);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, page.ID);
+        allocateTextureStorage(GL_TEXTURE_2D_ARRAY, upload, page.levels, page.width, page.height, page.layers);
+        for (std::size_t i = start; i < end; i++)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (int)(i - start), page.width, page.height, 1, upload.format, upload.type, loaded[i].pixels.get());
+            PackedImage &image = images[handles[i]];
+            image.page = (int)pageList.size();
+            image.layer = (int)(i - start);
+        }
+        // Each layer gets its own mips, layers never bleed into each other
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        applyTextureSwizzle(GL_TEXTURE_2D_ARRAY, upload);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        pageList.push_back(page);
+        start = end;
+    }
+}
+
+inline void TexturePacker::buildAtlases(const std::vector<LoadedImage> &loaded, const std::vector<int> &handles)
+{
+    int levels = 1;
+    while ((2 << (levels - 1)) <= gutter)
+    {
+        levels++;
+    }
+    const int align = 1 << (levels - 1);
+    auto roundUp = [align](int value) { return (value + align - 1) / align * align; };
+
+    std::vector<unsigned char> pixels;
+    TexturePage page{0, GL_TEXTURE_2D, 0, 0, 1, 0, levels};
+    int shelfX = 0, shelfY = 0, shelfHeight = 0;
+
+    for (std::size_t i = 0; i < loaded.size(); i++)
+    {
+        const LoadedImage &source = loaded[i];
+        PackedImage &image = images[handles[i]];
+        int cellWidth = roundUp(source.width + 2 * gutter);
+        int cellHeight = roundUp(source.height + 2 * gutter);
+        if (cellWidth > maxSize || cellHeight > maxSize)
+        {
+            std::cout << "ERROR::TEXTURE::PACKER::TOO_BIG " << requests[handles[i]].path << " doesn't fit a " << maxSize << "x" << maxSize << " atlas" << std::endl;
+            continue;
+        }
+
+        // Next shelf if the row is full, next page if the page is (or the channel count changes)
+        if (page.channels != 0 && shelfX + cellWidth > maxSize)
+        {
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+        }
+        if (page.channels != 0 && (shelfY + cellHeight > maxSize || page.channels != source.channels))
+        {
+            uploadAtlas(page, pixels);
+            page = TexturePage{0, GL_TEXTURE_2D, 0, 0, 1, 0, levels};
+            shelfX = shelfY = shelfHeight = 0;
+        }
+        if (page.channels == 0)
+        {
+            page.channels = source.channels;
+            pixels.assign((std::size_t)maxSize * maxSize * source.channels, 0);
+        }
+
+        // The image plus its gutter, which repeats the nearest edge pixel (what GL_CLAMP_TO_EDGE would sample)
+        int n = source.channels;
+        const unsigned char* in = source.pixels.get();
+        for (int y = 0; y < cellHeight; y++)
+        {
+            int sy = std::min(std::max(y - gutter, 0), source.height - 1);
+            unsigned char* out = pixels.data() + ((std::size_t)(shelfY + y) * maxSize + shelfX) * n;
+            for (int x = 0; x < cellWidth; x++)
+            {
+                int sx = std::min(std::max(x - gutter, 0), source.width - 1);
+                std::memcpy(out + x * n, in + ((std::size_t)sy * source.width + sx) * n, n);
+            }
+        }
+
+        image.page = (int)pageList.size();
+        image.layer = 0;
+        // Page size isn't final yet, uploadAtlas turns these pixel positions into UVs
+        image.uvOffset[0] = (float)(shelfX + gutter);
+        image.uvOffset[1] = (float)(shelfY + gutter);
+        page.width = std::max(page.width, shelfX + cellWidth);
+        page.height = std::max(page.height, shelfY + cellHeight);
+        shelfX += cellWidth;
+        shelfHeight = std::max(shelfHeight, cellHeight);
+    }
+    if (page.channels != 0)
+    {
+        uploadAtlas(page, pixels);
+    }
+}
+
+/**
+ * Crops the page to a power of two around what was used (so every level halves exactly & cells stay aligned),
+ * makes the mips with a 2x2 box filter on the CPU (a wider filter would reach into the neighbours), then uploads.
+ */
+inline void TexturePacker::uploadAtlas(TexturePage &page, const std::vector<unsigned char> &pixels)
+{
+    int width = 1, height = 1;
+    while (width < page.width) width *= 2;
+    while (height < page.height) height *= 2;
+    std::vector<unsigned char> cropped((std::size_t)width * height * page.channels, 0);
+    for (int y = 0; y < page.height; y++)
+    {
+        std::memcpy(cropped.data() + (std::size_t)y * width * page.channels, pixels.data() + (std::size_t)y * maxSize * page.channels, (std::size_t)page.width * page.channels);
+    }
+    page.width = width;
+    page.height = height;
+
+    for (PackedImage &image : images)
+    {
+        if (image.page == (int)pageList.size())
+        {
+            image.uvScale[0] = (float)image.width / width;
+            image.uvScale[1] = (float)image.height / height;
+            image.uvOffset[0] /= width;
+            image.uvOffset[1] /= height;
+        }
+    }
+
+    MipOptions options;
+    options.filter = MIP_FILTER_BOX;
+    std::vector<MipLevelData> mips = generateMipChain(cropped.data(), width, height, page.channels, MIP_UNORM8, options);
+    page.levels = std::min(page.levels, (int)mips.size() + 1);
+
+    TextureUploadFormat upload = chooseTextureFormat(page.channels, MIP_UNORM8);
+    glGenTextures(1, &page.ID);
+    glBindTexture(GL_TEXTURE_2D, page.ID);
+    allocateTextureStorage(GL_TEXTURE_2D, upload, page.levels, width, height);
+    uploadTextureLevel(GL_TEXTURE_2D, 0, upload, width, height, cropped.data());
+    for (int level = 1; level < page.levels; level++)
+    {
+        const MipLevelData &mip = mips[level - 1];
+        uploadTextureLevel(GL_TEXTURE_2D, level, upload, mip.width, mip.height, mip.pixels.data());
+    }
+    applyTextureSwizzle(GL_TEXTURE_2D, upload);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    pageList.push_back(page);
+}
+
+inline void TexturePacker::bind(int page, int unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(pageList[page].target, pageList[page].ID);
+}
+
+#endif
@@ -0,0 +1,780 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+#include "texture_format.h"
+#include "texture_upload.h"
+#include "mip_generator.h"
+#include "image_loader.h" // Also brings in stb_image.h
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Sampler state for the texture. Mipmaps are only made if minFilter uses them, on the decode thread with
+ * mip_generator.h (mipFilter, gammaCorrectMips), since the streamer uploads the smallest levels first.
+ * compression encodes every level to BC blocks on the decode thread too. It's ignored if the driver doesn't support
+ * the format.
+ * srgb is for color images: they're stored as GL_SRGB8(_ALPHA8) & the GPU turns them back to linear when sampling.
+ */
+struct TextureParams
+{
+    GLenum wrapS = GL_REPEAT;
+    GLenum wrapT = GL_REPEAT;
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    MipFilter mipFilter = MIP_FILTER_BOX;
+    bool gammaCorrectMips = false;
+    TextureCompression compression = TEXTURE_UNCOMPRESSED;
+    bool srgb = false;
+
+    bool mipmapped() const { return minFilter != GL_NEAREST && minFilter != GL_LINEAR; }
+};
+
+/**
+ * Rough VRAM a texture takes. A full mip chain adds a third on top of the base level (1/4 + 1/16 + ... = 1/3).
+ * Drivers pad RGB out to RGBA, so count 3 channels as 4.
+ */
+inline std::size_t textureGPUBytes(int width, int height, int channels, bool mipmapped)
+{
+    std::size_t bytes = (std::size_t)width * height * (channels == 3 ? 4 : channels);
+    return mipmapped ? bytes + bytes / 3 : bytes;
+}
+
+/**
+ * -- Texture Streaming --
+ * stbi_load + glTexImage2D on the main thread means the window sits there frozen until every image is decoded.
+ * This splits loading into two stages so the frame loop keeps going while textures trickle in:
+ *   1. Worker threads read the file & decode it with stbi_load_from_memory. No GL here, they don't own the context.
+ *   2. The render thread (update(), once per frame) copies decoded pixels into a pixel buffer object and calls
+ *      glTexImage2D from it. With a PBO bound the "pixels" argument is an offset into the buffer, so the driver
+ *      can do the actual transfer to the GPU on its own time instead of making us wait for it.
+ *
+ * The PBOs are a ring: each upload gets a glFenceSync behind it, and a slot is only written again once its fence
+ * says the GPU is done reading it. If every slot is still busy we just try again next frame.
+ *
+ * Textures sharpen as they go instead of popping in. load() only reads the file header (stbi_info) for the size,
+ * and puts a 1x1 grey texel in the smallest mip level, with GL_TEXTURE_BASE_LEVEL/MAX_LEVEL clamped to it. The
+ * worker then makes the whole mip chain & update() uploads levels smallest first, across all the textures at once,
+ * lowering GL_TEXTURE_BASE_LEVEL as each one lands. So load() costs the same for a 64x64 icon as for an 8K photo,
+ * every texture is usable on the first frame, & a frame never uploads much more than `budgetBytes`.
+ *
+ * Files ending in .baked (see texture_format.h) skip all of that: there's nothing to decode, so load() maps the file
+ * and uploads every level on the spot.
+ *
+ * Usage:
+ *     TextureStreamer streamer;
+ *     unsigned int texture = streamer.load("texture_lesson/container.jpg"); // Valid right away: grey, then sharper every frame
+ *     ...every frame...
+ *     streamer.update();
+ */
+class TextureStreamer
+{
+public:
+    /**
+     * `ringSlots` PBOs of at least `slotBytes` each (they grow if an image is bigger).
+     * `workers` decode threads, 0 = one per core minus the render thread.
+     */
+    TextureStreamer(int workers = 0, int ringSlots = 4, std::size_t slotBytes = 4 * 1024 * 1024);
+    ~TextureStreamer();
+
+    // Render thread. Makes the texture object right away & queues the file for decoding. `flip` is for images stored top row first (png, jpg).
+    unsigned int load(const std::string &path, bool flip = false, const TextureParams &params = TextureParams());
+
+    /**
+     * Render thread, once per frame. Frees slots whose fence has passed and uploads decoded images until
+     * `budgetBytes` have been sent this frame, so one frame never eats a whole batch of huge textures.
+     */
+    void update(std::size_t budgetBytes = 8 * 1024 * 1024);
+
+    bool isReady(unsigned int texture) const;
+    // What gpuBytes() says for a texture whose file couldn't be read or decoded. It stays the grey placeholder.
+    static constexpr std::size_t LOAD_FAILED = (std::size_t)-1;
+    // Estimated VRAM of a finished texture (textureGPUBytes), 0 while it's still on the way, LOAD_FAILED if it never will be.
+    std::size_t gpuBytes(unsigned int texture) const;
+    // Stop tracking a texture that's about to be deleted, since GL may hand its ID out again. Its request is dropped
+    // wherever it is (queued, being decoded, waiting to upload), nothing more gets written to it.
+    void forget(unsigned int texture);
+    // Textures still being read, decoded or uploaded
+    int pending() const;
+    // Sharpest mip level uploaded so far, 0 once it's all there. -1 while it's still just the placeholder (or unknown).
+    int residentLevel(unsigned int texture) const;
+
+private:
+    struct Request
+    {
+        std::string path;
+        bool flip;
+        TextureParams params;
+        unsigned int texture;
+        int channels; // Decided in load() along with the placeholder's format, the decode has to match it
+        std::uint64_t ticket; // Tells apart two loads of the same texture ID, when the first one was forgotten
+    };
+
+    // A request a worker is decoding right now
+    struct Working
+    {
+        std::uint64_t ticket;
+        unsigned int texture;
+        bool cancelled; // forget() was called, the worker throws the result away
+    };
+
+    struct Decoded
+    {
+        unsigned int texture;
+        TextureParams params;
+        unsigned char* pixels; // From stbi, NULL if the load failed
+        int width, height, channels;
+        std::vector<MipLevelData> mips; // Levels 1+, if minFilter uses mipmaps
+        std::vector<unsigned char> compressedBase; // Level 0 as BC blocks, mips are compressed in place
+        int nextLevel; // Next one update() uploads, counting down to 0. The ones above it are already there.
+
+        bool compressed() const { return !compressedBase.empty(); }
+        int levelWidth(int level) const { return level == 0 ? width : mips[level - 1].width; }
+        int levelHeight(int level) const { return level == 0 ? height : mips[level - 1].height; }
+        const unsigned char* levelPixels(int level) const { return level != 0 ? mips[level - 1].pixels.data() : compressed() ? compressedBase.data() : pixels; }
+        std::size_t levelBytes(int level) const { return level != 0 ? mips[level - 1].pixels.size() : compressed() ? compressedBase.size() : (std::size_t)width * height * channels; }
+    };
+
+    struct Finished
+    {
+        unsigned int texture;
+        std::size_t bytes;
+    };
+
+    struct Slot
+    {
+        unsigned int buffer;
+        std::size_t capacity;
+        GLsync fence;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<Slot> slots;
+    int nextSlot;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<Request> requests; // Waiting for a worker
+    std::deque<Decoded> decoded;  // Waiting for the render thread
+    std::vector<Working> working; // With a worker
+    bool stopping;
+
+    std::vector<Decoded> uploading; // Render thread only, some of their levels are still to go
+
+    std::vector<Finished> ready;
+    int inFlight;
+    std::uint64_t nextTicket;
+    bool expandRGB; // Driver pads RGB8 to RGBA8 anyway, so decode RGB images as RGBA (see texture_upload.h)
+
+    void run();
+    Slot* freeSlot();
+};
+
+// Whether the driver can take this block format as is (see loadGLExtensions)
+inline bool compressionSupported(TextureCompression compression)
+{
+    switch (compression)
+    {
+    case TEXTURE_BC1: case TEXTURE_BC3: return GLExt.textureCompressionS3TC;
+    case TEXTURE_BC7: return GLExt.textureCompressionBPTC;
+    default: return true;
+    }
+}
+
+/**
+ * Uploads a .baked file into `texture` straight from an mmap of it, one glTexImage2D per stored mip level.
+ * Compressed files go up as is if the driver supports the format, otherwise they get decoded to RGBA first.
+ * Returns false (texture untouched) if the file is missing or isn't a valid baked texture.
+ */
+inline bool loadBakedTexture(const char* path, unsigned int texture, std::size_t &gpuBytes)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        return false;
+    }
+    std::size_t size = (std::size_t)info.st_size;
+    void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+    const unsigned char* data = (const unsigned char*)mapped;
+    if (!validBakedTexture(data, size))
+    {
+        munmap(mapped, size);
+        return false;
+    }
+
+    BakedTextureHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    TextureCompression compression = (TextureCompression)header.compression;
+    bool decodeOnCPU = compression != TEXTURE_UNCOMPRESSED && !compressionSupported(compression);
+    std::vector<unsigned char> decoded;
+    // Baked with a sized internal format already, this only picks the source format/type & the swizzle
+    TextureUploadFormat upload = chooseTextureFormat(header.channels, MIP_UNORM8);
+    GLenum internalFormat = decodeOnCPU ? GL_RGBA8 : compression == TEXTURE_UNCOMPRESSED ? upload.internalFormat : header.internalFormat;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // Every level at once if the driver can make it immutable (see allocateTextureStorage), then they're filled in below
+    bool immutable = GLExt.textureStorage;
+    if (immutable)
+    {
+        GLExt.TexStorage2D(GL_TEXTURE_2D, header.levels, internalFormat, header.width, header.height);
+    }
+    gpuBytes = 0;
+    for (std::uint32_t i = 0; i < header.levels; i++)
+    {
+        BakedTextureLevel level;
+        std::memcpy(&level, data + sizeof(BakedTextureHeader) + i * sizeof(BakedTextureLevel), sizeof(level));
+        if (compression == TEXTURE_UNCOMPRESSED)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, textureUnpackAlignment(data + level.offset, (std::size_t)level.width * upload.bytesPerPixel));
+            if (immutable)
+            {
+                glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, upload.format, upload.type, data + level.offset);
+            }
+            else
+            {
+                glTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, upload.format, upload.type, data + level.offset);
+            }
+            gpuBytes += textureGPUBytes(level.width, level.height, header.channels, false);
+        }
+        else if (!decodeOnCPU)
+        {
+            if (immutable)
+            {
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, internalFormat, (GLsizei)level.size, data + level.offset);
+            }
+            else
+            {
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, (GLsizei)level.size, data + level.offset);
+            }
+            gpuBytes += level.size;
+        }
+        else
+        {
+            // The driver can't sample this format, so expand it back to RGBA. Same picture, just 4-8x the memory.
+            decoded.resize((std::size_t)level.width * level.height * 4);
+            decompressTexture(data + level.offset, level.width, level.height, compression, decoded.data());
+            if (immutable)
+            {
+                glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+            }
+            else
+            {
+                glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+            }
+            gpuBytes += decoded.size();
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (compression == TEXTURE_UNCOMPRESSED)
+    {
+        applyTextureSwizzle(GL_TEXTURE_2D, upload);
+    }
+    // Otherwise GL expects levels all the way down to 1x1 & treats the texture as incomplete if any are missing
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levels - 1);
+
+    munmap(mapped, size);
+    return true;
+}
+
+inline TextureStreamer::TextureStreamer(int workerCount, int ringSlots, std::size_t slotBytes) : nextSlot(0), stopping(false), inFlight(0), nextTicket(0)
+{
+    // Asked here, on the render thread, the workers only read the answer
+    expandRGB = chooseTextureFormat(3, MIP_UNORM8).decodeChannels == 4;
+
+    for (int i = 0; i < (ringSlots < 1 ? 1 : ringSlots); i++)
+    {
+        Slot slot{0, slotBytes, NULL};
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, slotBytes, NULL, GL_STREAM_DRAW);
+        slots.push_back(slot);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (workerCount <= 0)
+    {
+        int cores = (int)std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+    for (int i = 0; i < workerCount; i++)
+    {
+        workers.push_back(std::thread(&TextureStreamer::run, this));
+    }
+}
+
+/**
+ * Only stops the workers & frees the CPU side. The GL objects go away with the context, same as the rest of the lesson.
+ */
+inline TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+    for (Decoded &image : decoded)
+    {
+        stbi_image_free(image.pixels);
+    }
+    for (Decoded &image : uploading)
+    {
+        stbi_image_free(image.pixels);
+    }
+}
+
+inline unsigned int TextureStreamer::load(const std::string &path, bool flip, const TextureParams &requested)
+{
+    TextureParams params = requested;
+    if (!compressionSupported(params.compression))
+    {
+        params.compression = TEXTURE_UNCOMPRESSED;
+    }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, params.wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, params.wrapT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, params.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, params.magFilter);
+    // Something to sample until the real thing arrives. An empty texture is "incomplete" and samples as black.
+    const unsigned char grey[4] = {128, 128, 128, 255};
+
+    // Baked files are already in their final form, no reason to send them through the workers
+    const std::string baked = ".baked";
+    if (path.size() > baked.size() && path.compare(path.size() - baked.size(), baked.size(), baked) == 0)
+    {
+        std::size_t bytes = 0;
+        if (loadBakedTexture(path.c_str(), texture, bytes))
+        {
+            ready.push_back(Finished{texture, bytes});
+        }
+        else
+        {
+            std::cout << "ERROR::TEXTURE::STREAMER::LOAD_FAILED " << path << std::endl;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            ready.push_back(Finished{texture, LOAD_FAILED});
+        }
+        return texture;
+    }
+
+    // Only reads the header, the decode happens on a worker. Mapping it (see MappedFile) also has the kernel start
+    // reading the rest of the file in the background, so it's in memory by the time a worker gets there.
+    MappedFile file;
+    int width = 0, height = 0, fileChannels = 0;
+    if (!file.open(path.c_str()) || !stbi_info_from_memory(file.data(), (int)file.size(), &width, &height, &fileChannels))
+    {
+        std::cout << "ERROR::TEXTURE::STREAMER::LOAD_FAILED " << path << ": " << (file.data() != NULL ? stbi_failure_reason() : "can't open") << std::endl;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        ready.push_back(Finished{texture, LOAD_FAILED});
+        return texture;
+    }
+    // Block compression takes RGB as is, padding it would only make more work for the encoder
+    int channels = fileChannels == 3 && expandRGB && params.compression == TEXTURE_UNCOMPRESSED ? 4 : fileChannels;
+
+    // The smallest level is always 1x1, so the grey texel fits it exactly. Without mipmaps it stands in for level 0,
+    // unless the storage is immutable: that's allocated at its final size up front, so it gets the whole chain anyway.
+    int top = params.mipmapped() || GLExt.textureStorage ? textureMipLevels(width, height) - 1 : 0;
+    if (params.compression != TEXTURE_UNCOMPRESSED)
+    {
+        GLenum format = compressedGLFormat(params.compression);
+        std::vector<unsigned char> block = compressTexture(grey, 1, 1, channels, params.compression, 1);
+        if (GLExt.textureStorage)
+        {
+            GLExt.TexStorage2D(GL_TEXTURE_2D, top + 1, format, width, height);
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, top, 0, 0, 1, 1, format, (GLsizei)block.size(), block.data());
+        }
+        else
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, top, format, 1, 1, 0, (GLsizei)block.size(), block.data());
+        }
+    }
+    else
+    {
+        // Same format as the real levels will have, or the texture would be incomplete once they start arriving
+        TextureUploadFormat upload = chooseTextureFormat(channels, MIP_UNORM8, params.srgb);
+        if (GLExt.textureStorage)
+        {
+            allocateTextureStorage(GL_TEXTURE_2D, upload, top + 1, width, height);
+            glTexSubImage2D(GL_TEXTURE_2D, top, 0, 0, 1, 1, upload.format, upload.type, grey);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, top, upload.internalFormat, 1, 1, 0, upload.format, upload.type, grey);
+        }
+        applyTextureSwizzle(GL_TEXTURE_2D, upload);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, top);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, top);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        requests.push_back(Request{path, flip, params, texture, channels, nextTicket++});
+    }
+    inFlight++;
+    wake.notify_one();
+    return texture;
+}
+
+inline void TextureStreamer::run()
+{
+    std::vector<unsigned char> file;
+    while (true)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this] { return stopping || !requests.empty(); });
+            if (stopping)
+            {
+                return;
+            }
+            request = requests.front();
+            requests.pop_front();
+            working.push_back(Working{request.ticket, request.texture, false});
+        }
+
+        Decoded image{request.texture, request.params, NULL, 0, 0, 0, std::vector<MipLevelData>(), std::vector<unsigned char>(), 0};
+        // Sets the flip per thread, see image_loader.h
+        ImageRequest job;
+        job.path = request.path;
+        job.flip = request.flip;
+        job.channels = request.channels;
+        LoadedImage loaded = loadImage(job, file);
+        image.width = loaded.width;
+        image.height = loaded.height;
+        image.channels = loaded.channels;
+        image.pixels = loaded.pixels.release();
+        if (image.pixels == NULL)
+        {
+            std::cout << "ERROR::TEXTURE::STREAMER::LOAD_FAILED " << request.path << std::endl;
+        }
+        else if (request.params.mipmapped())
+        {
+            MipOptions options;
+            options.filter = request.params.mipFilter;
+            options.gammaCorrect = request.params.gammaCorrectMips;
+            options.threads = 1; // The other workers are busy with other images already
+            image.mips = generateMipChain(image.pixels, image.width, image.height, image.channels, MIP_UNORM8, options);
+        }
+        if (image.pixels != NULL && request.params.compression != TEXTURE_UNCOMPRESSED)
+        {
+            image.compressedBase = compressTexture(image.pixels, image.width, image.height, image.channels, request.params.compression, 1);
+            for (MipLevelData &mip : image.mips)
+            {
+                mip.pixels = compressTexture(mip.pixels.data(), mip.width, mip.height, image.channels, request.params.compression, 1);
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        bool cancelled = false;
+        for (std::size_t i = 0; i < working.size(); i++)
+        {
+            if (working[i].ticket == request.ticket)
+            {
+                cancelled = working[i].cancelled;
+                working.erase(working.begin() + i);
+                break;
+            }
+        }
+        if (cancelled)
+        {
+            stbi_image_free(image.pixels); // The texture's gone (or its ID is someone else's now)
+            continue;
+        }
+        decoded.push_back(std::move(image));
+    }
+}
+
+inline TextureStreamer::Slot* TextureStreamer::freeSlot()
+{
+    Slot &slot = slots[nextSlot];
+    if (slot.fence != NULL)
+    {
+        // Timeout 0 => just ask, never wait
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            return NULL;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = NULL;
+    }
+    nextSlot = (nextSlot + 1) % (int)slots.size();
+    return &slot;
+}
+
+inline void TextureStreamer::update(std::size_t budgetBytes)
+{
+    {
+        std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+        while (guard.owns_lock() && !decoded.empty())
+        {
+            Decoded image = std::move(decoded.front());
+            decoded.pop_front();
+            if (image.pixels == NULL)
+            {
+                ready.push_back(Finished{image.texture, LOAD_FAILED});
+                inFlight--; // The placeholder stays, the worker already said why
+                continue;
+            }
+            image.nextLevel = (int)image.mips.size();
+            uploading.push_back(std::move(image));
+        }
+    }
+
+    std::size_t sent = 0;
+    while (sent < budgetBytes && !uploading.empty())
+    {
+        Slot* slot = freeSlot();
+        if (slot == NULL)
+        {
+            break; // Ring is full, try again next frame
+        }
+
+        // Fill the slot with the smallest levels still to go, whichever textures they're from, so everything
+        // sharpens at the same pace instead of one texture at a time. Offsets stay 8 byte aligned for GL_UNPACK_ALIGNMENT.
+        std::vector<std::pair<std::size_t, int>> batch; // (index in uploading, level)
+        std::vector<std::size_t> offsets;
+        std::size_t bytes = 0;
+        while (true)
+        {
+            std::size_t pick = uploading.size();
+            for (std::size_t i = 0; i < uploading.size(); i++)
+            {
+                if (uploading[i].nextLevel >= 0 && (pick == uploading.size() || uploading[i].levelBytes(uploading[i].nextLevel) < uploading[pick].levelBytes(uploading[pick].nextLevel)))
+                {
+                    pick = i;
+                }
+            }
+            if (pick == uploading.size())
+            {
+                break;
+            }
+            std::size_t offset = (bytes + 7) / 8 * 8;
+            std::size_t levelBytes = uploading[pick].levelBytes(uploading[pick].nextLevel);
+            // Always at least one level, even if it's bigger than the slot or the budget on its own
+            if (!batch.empty() && (offset + levelBytes > slot->capacity || sent + offset + levelBytes > budgetBytes))
+            {
+                break;
+            }
+            batch.push_back(std::make_pair(pick, uploading[pick].nextLevel--));
+            offsets.push_back(offset);
+            bytes = offset + levelBytes;
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer);
+        if (bytes > slot->capacity)
+        {
+            slot->capacity = bytes;
+        }
+        // Orphan the old storage, so the map below never has to wait for a previous upload from this buffer.
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, slot->capacity, NULL, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped != NULL)
+        {
+            for (std::size_t i = 0; i < batch.size(); i++)
+            {
+                const Decoded &image = uploading[batch[i].first];
+                std::memcpy((unsigned char*)mapped + offsets[i], image.levelPixels(batch[i].second), image.levelBytes(batch[i].second));
+            }
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else
+        {
+            std::cout << "ERROR::TEXTURE::STREAMER::MAP_FAILED, uploading directly" << std::endl;
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        for (std::size_t i = 0; i < batch.size(); i++)
+        {
+            const Decoded &image = uploading[batch[i].first];
+            int level = batch[i].second;
+            int width = image.levelWidth(level), height = image.levelHeight(level);
+            // With the PBO bound the last argument is an offset into it, without it's a pointer to the pixels
+            const void* source = mapped != NULL ? (const void*)offsets[i] : (const void*)image.levelPixels(level);
+            glBindTexture(GL_TEXTURE_2D, image.texture);
+            // Immutable textures already have every level, they only get filled in
+            if (image.compressed())
+            {
+                GLenum format = compressedGLFormat(image.params.compression);
+                if (GLExt.textureStorage)
+                {
+                    glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, format, (GLsizei)image.levelBytes(level), source);
+                }
+                else
+                {
+                    glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, (GLsizei)image.levelBytes(level), source);
+                }
+            }
+            else
+            {
+                // Rows of an RGB image aren't a multiple of 4 bytes unless the width happens to be
+                TextureUploadFormat upload = chooseTextureFormat(image.channels, MIP_UNORM8, image.params.srgb);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, textureUnpackAlignment(source, (std::size_t)width * upload.bytesPerPixel));
+                if (GLExt.textureStorage)
+                {
+                    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, upload.format, upload.type, source);
+                }
+                else
+                {
+                    glTexImage2D(GL_TEXTURE_2D, level, upload.internalFormat, width, height, 0, upload.format, upload.type, source);
+                }
+            }
+            // Everything from here down to the placeholder level is in, so sampling can use it
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        sent += bytes;
+
+        for (std::size_t i = 0; i < uploading.size(); )
+        {
+            Decoded &image = uploading[i];
+            if (image.nextLevel >= 0)
+            {
+                i++;
+                continue;
+            }
+            std::size_t gpuBytes = 0;
+            for (int level = 0; image.compressed() && level <= (int)image.mips.size(); level++)
+            {
+                gpuBytes += image.levelBytes(level);
+            }
+            ready.push_back(Finished{image.texture, image.compressed() ? gpuBytes : textureGPUBytes(image.width, image.height, image.channels, image.params.mipmapped() || GLExt.textureStorage)});
+            stbi_image_free(image.pixels);
+            if (i + 1 != uploading.size())
+            {
+                image = std::move(uploading.back());
+            }
+            uploading.pop_back();
+            inFlight--;
+        }
+    }
+}
+
+inline bool TextureStreamer::isReady(unsigned int texture) const
+{
+    std::size_t bytes = gpuBytes(texture);
+    return bytes > 0 && bytes != LOAD_FAILED;
+}
+
+inline std::size_t TextureStreamer::gpuBytes(unsigned int texture) const
+{
+    for (const Finished &done : ready)
+    {
+        if (done.texture == texture)
+        {
+            return done.bytes;
+        }
+    }
+    return 0;
+}
+
+inline void TextureStreamer::forget(unsigned int texture)
+{
+    for (std::size_t i = 0; i < ready.size(); i++)
+    {
+        if (ready[i].texture == texture)
+        {
+            ready[i] = ready.back();
+            ready.pop_back();
+            return;
+        }
+    }
+    // Anything still on the way would otherwise keep writing levels into whatever texture gets the ID next
+    for (std::size_t i = 0; i < uploading.size(); i++)
+    {
+        if (uploading[i].texture == texture)
+        {
+            stbi_image_free(uploading[i].pixels);
+            uploading.erase(uploading.begin() + i);
+            inFlight--;
+            return;
+        }
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    for (std::size_t i = 0; i < requests.size(); i++)
+    {
+        if (requests[i].texture == texture)
+        {
+            requests.erase(requests.begin() + i);
+            inFlight--;
+            return;
+        }
+    }
+    for (Working &work : working)
+    {
+        if (work.texture == texture && !work.cancelled)
+        {
+            work.cancelled = true;
+            inFlight--;
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < decoded.size(); i++)
+    {
+        if (decoded[i].texture == texture)
+        {
+            stbi_image_free(decoded[i].pixels);
+            decoded.erase(decoded.begin() + i);
+            inFlight--;
+            return;
+        }
+    }
+}
+
+inline int TextureStreamer::pending() const
+{
+    return inFlight;
+}
+
+inline int TextureStreamer::residentLevel(unsigned int texture) const
+{
+    if (isReady(texture))
+    {
+        return 0;
+    }
+    for (const Decoded &image : uploading)
+    {
+        if (image.texture == texture)
+        {
+            // nextLevel starts at the smallest level, so nothing's in until it moves
+            return image.nextLevel < (int)image.mips.size() ? image.nextLevel + 1 : -1;
+        }
+    }
+    return -1;
+}
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+#include "mip_generator.h" // MipPixelType
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * -- Texture Upload Formats --
+ * glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, ..., GL_RGBA, GL_UNSIGNED_BYTE, pixels) works, but the driver has to convert
+ * every pixel on the way in, and an unsized internal format like GL_RGB lets it pick whatever precision it likes.
+ * This picks everything from what was actually decoded (channel count & bits per channel):
+ *   - A sized internal format: GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 (GL_SRGB8 / GL_SRGB8_ALPHA8 for sRGB color),
+ *     GL_R16 ... GL_RGBA16 for 16 bit data, GL_R16F ... GL_RGBA16F for float data (GL_R32F ... if asked).
+ *   - The source format & type that describe the bytes exactly as they are.
+ *   - GL_UNPACK_ALIGNMENT from the row size, since the default of 4 breaks any RGB image whose width isn't a
+ *     multiple of 4.
+ *
+ * With GL_ARB_internalformat_query2 (see gl_extensions.h) it also asks the driver what it would rather have:
+ *   - If RGBA8 is really stored as BGRA (most desktop GPUs), our RGBA bytes go up labelled GL_BGRA, so they're
+ *     copied as is, and GL_TEXTURE_SWIZZLE swaps red & blue back when sampling. Nobody touches the pixels.
+ *   - If RGB8 gets padded to RGBA8 anyway, decodeChannels says 4: decode as RGBA (stbi does it while converting)
+ *     and choose again, instead of the driver repacking every pixel.
+ * The answers are asked once per internal format & remembered. Without the extension it's the plain table.
+ *
+ * stbi's 1 & 2 channel images are grey & grey + alpha, but GL_R8 / GL_RG8 sample as (R, 0, 0, 1) / (R, G, 0, 1).
+ * applyTextureSwizzle puts them back to (R, R, R, 1) / (R, R, R, G).
+ *
+ * Usage:
+ *     TextureUploadFormat upload = chooseTextureFormat(channels, MIP_UNORM8);
+ *     glTexImage2D(GL_TEXTURE_2D, 0, upload.internalFormat, width, height, 0, upload.format, upload.type, NULL);
+ *     uploadTextureLevel(GL_TEXTURE_2D, 0, upload, width, height, pixels); // Sets the unpack alignment too
+ *     applyTextureSwizzle(GL_TEXTURE_2D, upload);
+ */
+struct TextureUploadFormat
+{
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+    int channels;       // In the pixels handed to GL
+    int bytesPerPixel;
+    int decodeChannels; // What the image should be decoded to. If it's not `channels`, decode to this & choose again.
+    bool swapRedBlue;   // Uploaded as BGRA, needs applyTextureSwizzle (so do 1 & 2 channel formats)
+};
+
+// What the driver said about one internal format
+struct TextureFormatPreference
+{
+    GLenum internalFormat;
+    GLint preferred;   // GL_INTERNALFORMAT_PREFERRED, what it's really stored as
+    GLint imageFormat; // GL_TEXTURE_IMAGE_FORMAT / _TYPE, the source it copies fastest
+    GLint imageType;
+};
+
+// Render thread only, like every other GL call
+inline TextureFormatPreference textureFormatPreference(GLenum internalFormat)
+{
+    static std::vector<TextureFormatPreference> asked;
+    for (const TextureFormatPreference &preference : asked)
+    {
+        if (preference.internalFormat == internalFormat)
+        {
+            return preference;
+        }
+    }
+    TextureFormatPreference preference{internalFormat, (GLint)internalFormat, 0, 0};
+    if (GLExt.internalformatQuery2)
+    {
+        GLExt.GetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_INTERNALFORMAT_PREFERRED, 1, &preference.preferred);
+        GLExt.GetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_TEXTURE_IMAGE_FORMAT, 1, &preference.imageFormat);
+        GLExt.GetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_TEXTURE_IMAGE_TYPE, 1, &preference.imageType);
+    }
+    asked.push_back(preference);
+    return preference;
+}
+
+/**
+ * `srgb` is for color images (8 bit RGB/RGBA only, GL has no sRGB for the others).
+ * `halfFloat` stores MIP_FLOAT32 data as 16 bit floats, half the memory & plenty for HDR color. The driver converts
+ * from GL_FLOAT on upload, that one conversion is the price.
+ */
+inline TextureUploadFormat chooseTextureFormat(int channels, MipPixelType type, bool srgb = false, bool halfFloat = true)
+{
+    static const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    static const GLenum unorm8[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    static const GLenum unorm16[4] = {GL_R16, GL_RG16, GL_RGB16, GL_RGBA16};
+    static const GLenum float16[4] = {GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F};
+    static const GLenum float32[4] = {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F};
+    channels = channels < 1 ? 1 : channels > 4 ? 4 : channels;
+    int i = channels - 1;
+
+    TextureUploadFormat upload;
+    upload.format = formats[i];
+    upload.channels = channels;
+    upload.decodeChannels = channels;
+    upload.swapRedBlue = false;
+    upload.bytesPerPixel = channels * mipPixelTypeBytes(type);
+    switch (type)
+    {
+    case MIP_UNORM16:
+        upload.internalFormat = unorm16[i];
+        upload.type = GL_UNSIGNED_SHORT;
+        break;
+    case MIP_FLOAT32:
+        upload.internalFormat = halfFloat ? float16[i] : float32[i];
+        upload.type = GL_FLOAT;
+        break;
+    case MIP_UNORM8:
+    default:
+        upload.internalFormat = srgb && channels == 3 ? GL_SRGB8 : srgb && channels == 4 ? GL_SRGB8_ALPHA8 : unorm8[i];
+        upload.type = GL_UNSIGNED_BYTE;
+        break;
+    }
+
+    if (GLExt.internalformatQuery2 && type == MIP_UNORM8)
+    {
+        TextureFormatPreference preference = textureFormatPreference(upload.internalFormat);
+        if (channels == 3 && (preference.preferred == GL_RGBA8 || preference.preferred == GL_SRGB8_ALPHA8))
+        {
+            upload.decodeChannels = 4;
+        }
+        // GL_UNSIGNED_BYTE or GL_UNSIGNED_INT_8_8_8_8_REV, both are the bytes B G R A in memory
+        if (channels == 4 && preference.imageFormat == GL_BGRA && (preference.imageType == GL_UNSIGNED_BYTE || preference.imageType == GL_UNSIGNED_INT_8_8_8_8_REV))
+        {
+            upload.format = GL_BGRA;
+            upload.type = (GLenum)preference.imageType;
+            upload.swapRedBlue = true;
+        }
+    }
+    return upload;
+}
+
+/**
+ * The biggest GL_UNPACK_ALIGNMENT (8, 4, 2 or 1) that both the start of the pixels & the row size are multiples of.
+ * With a PBO bound `pixels` is the offset into it, which is what counts then.
+ */
+inline int textureUnpackAlignment(const void* pixels, std::size_t rowBytes)
+{
+    std::uintptr_t address = (std::uintptr_t)pixels;
+    for (int alignment = 8; alignment > 1; alignment /= 2)
+    {
+        if (address % alignment == 0 && rowBytes % alignment == 0)
+        {
+            return alignment;
+        }
+    }
+    return 1;
+}
+
+/**
+ * glTexSubImage2D of a whole level that's already allocated, with the unpack alignment set to match the rows.
+ * Puts GL_UNPACK_ALIGNMENT back to GL's default of 4 afterwards, which is what the rest of the code expects.
+ */
+inline void uploadTextureLevel(GLenum target, int level, const TextureUploadFormat &upload, int width, int height, const void* pixels)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, textureUnpackAlignment(pixels, (std::size_t)width * upload.bytesPerPixel));
+    glTexSubImage2D(target, level, 0, 0, width, height, upload.format, upload.type, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// Levels in a full mip chain down to 1x1, i.e. 1 + log2 of the bigger side
+inline int textureMipLevels(int width, int height)
+{
+    int levels = 1;
+    for (int size = width > height ? width : height; size > 1; size /= 2)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+/**
+ * Allocates `levels` mip levels for the texture bound to `target` (GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY with `layers`),
+ * to be filled with glTexSubImage after. With GL_ARB_texture_storage that's one glTexStorage2D/3D: the texture is
+ * immutable from then on, its size, format & level count can't change, so the driver can lay it out once & skip the
+ * completeness checks every time it's bound. Without it, one glTexImage(NULL) per level & GL_TEXTURE_MAX_LEVEL, which
+ * looks the same from the outside.
+ * No GL_PIXEL_UNPACK_BUFFER bound please, NULL would mean offset 0 in it.
+ */
+inline void allocateTextureStorage(GLenum target, const TextureUploadFormat &upload, int levels, int width, int height, int layers = 1)
+{
+    if (GLExt.textureStorage)
+    {
+        if (target == GL_TEXTURE_2D_ARRAY)
+        {
+            GLExt.TexStorage3D(target, levels, upload.internalFormat, width, height, layers);
+        }
+        else
+        {
+            GLExt.TexStorage2D(target, levels, upload.internalFormat, width, height);
+        }
+        return;
+    }
+    for (int level = 0; level < levels; level++)
+    {
+        int levelWidth = width >> level > 1 ? width >> level : 1;
+        int levelHeight = height >> level > 1 ? height >> level : 1;
+        if (target == GL_TEXTURE_2D_ARRAY)
+        {
+            glTexImage3D(target, level, upload.internalFormat, levelWidth, levelHeight, layers, 0, upload.format, upload.type, NULL);
+        }
+        else
+        {
+            glTexImage2D(target, level, upload.internalFormat, levelWidth, levelHeight, 0, upload.format, upload.type, NULL);
+        }
+    }
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+// Sets GL_TEXTURE_SWIZZLE_RGBA on the bound texture so it samples like the image did. A GL_R8 texture would
+// otherwise come out red (R,0,0,1) & a GL_RG8 one red-green with no alpha, instead of grey & grey + alpha.
+// It's a texture parameter, so once per texture (bound to `target`) is enough.
+inline void applyTextureSwizzle(GLenum target, const TextureUploadFormat &upload)
+{
+    if (upload.channels == 1)
+    {
+        const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    else if (upload.channels == 2)
+    {
+        const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+        glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    else if (upload.swapRedBlue)
+    {
+        const GLint swizzle[4] = {GL_BLUE, GL_GREEN, GL_RED, GL_ALPHA};
+        glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+}
+
+#endif
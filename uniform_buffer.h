@@ -0,0 +1,267 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+/**
+ * -- Uniform Buffer Objects (std140) --
+ * Instead of one glUniform call per value per program, per-frame data (camera, time, lights) goes into one struct,
+ * gets uploaded once per frame with a single glBufferSubData, and every program that declares the same block
+ * reads it through a binding point.
+ *
+ * The catch is that GLSL lays the block out with the std140 rules while C++ uses its own. So the struct is declared
+ * once with STD140_BLOCK, and from that one declaration we get:
+ *   1. The C++ struct itself, built from types whose C++ layout matches std140 (Std140Vec4, Std140Mat4, ...)
+ *   2. A static_assert that recomputes every std140 offset by hand & compares it to what the compiler actually did
+ *   3. The matching GLSL declaration (UniformBuffer<T>::glsl()) to paste/include into shaders
+ *   4. A runtime check against the linked program's offsets when the block gets bound (bindUniformBlock)
+ *
+ * Usage:
+ *     #define FRAME_UNIFORMS(MEMBER) \
+ *         MEMBER(Std140Mat4, view) \
+ *         MEMBER(Std140Vec4, cameraPosition) \
+ *         MEMBER(float, time)
+ *     STD140_BLOCK(FrameUniforms, FRAME_UNIFORMS)
+ *
+ *     UniformBuffer<FrameUniforms> frameBuffer(0, 3); // binding point 0, ring of 3 slots
+ *     shaderProgram.bindUniformBlock(frameBuffer);    // Once per program
+ *     frameData.time = glfwGetTime();
+ *     frameBuffer.update(frameData);                  // Once per frame, every program sees it
+ *
+ * There is no Std140Vec3 on purpose: a GLSL vec3 is 12 bytes aligned to 16, which C++ can't express. Use a vec4.
+ * Arrays have a comma in their type, which breaks the macro. Give them an alias first: using Weights = Std140Array<float, 4>;
+ */
+
+struct Std140Vec2
+{
+    alignas(8) float value[2];
+};
+
+struct Std140Vec4
+{
+    alignas(16) float value[4];
+};
+
+// A mat3 is stored as three vec4 columns in std140, so the last float of each column is padding.
+struct Std140Mat3
+{
+    alignas(16) float value[12];
+};
+
+struct Std140Mat4
+{
+    alignas(16) float value[16];
+};
+
+// std140 rounds the stride of every array element up to 16 bytes, even for a float[].
+template <typename T, std::size_t N>
+struct Std140Array
+{
+    struct Element
+    {
+        alignas(16) T value;
+    };
+    Element elements[N];
+
+    T& operator[](std::size_t i) { return elements[i].value; }
+    const T& operator[](std::size_t i) const { return elements[i].value; }
+};
+
+/**
+ * What std140 says about each type: base alignment, size and the GLSL name. These are written out from the spec
+ * (section 7.6.2.2 of the GL 4.6 spec) rather than from sizeof, that's the whole point of checking against them.
+ */
+template <typename T>
+struct Std140Traits;
+
+template <> struct Std140Traits<float>        { static constexpr std::size_t align = 4;  static constexpr std::size_t size = 4;  static constexpr std::size_t count = 0; static constexpr const char* glsl = "float"; };
+template <> struct Std140Traits<int>          { static constexpr std::size_t align = 4;  static constexpr std::size_t size = 4;  static constexpr std::size_t count = 0; static constexpr const char* glsl = "int"; };
+template <> struct Std140Traits<unsigned int> { static constexpr std::size_t align = 4;  static constexpr std::size_t size = 4;  static constexpr std::size_t count = 0; static constexpr const char* glsl = "uint"; };
+template <> struct Std140Traits<Std140Vec2>   { static constexpr std::size_t align = 8;  static constexpr std::size_t size = 8;  static constexpr std::size_t count = 0; static constexpr const char* glsl = "vec2"; };
+template <> struct Std140Traits<Std140Vec4>   { static constexpr std::size_t align = 16; static constexpr std::size_t size = 16; static constexpr std::size_t count = 0; static constexpr const char* glsl = "vec4"; };
+template <> struct Std140Traits<Std140Mat3>   { static constexpr std::size_t align = 16; static constexpr std::size_t size = 48; static constexpr std::size_t count = 0; static constexpr const char* glsl = "mat3"; };
+template <> struct Std140Traits<Std140Mat4>   { static constexpr std::size_t align = 16; static constexpr std::size_t size = 64; static constexpr std::size_t count = 0; static constexpr const char* glsl = "mat4"; };
+
+template <typename T, std::size_t N>
+struct Std140Traits<Std140Array<T, N>>
+{
+    static constexpr std::size_t stride = (Std140Traits<T>::size + 15) / 16 * 16;
+    static constexpr std::size_t align = 16;
+    static constexpr std::size_t size = stride * N;
+    static constexpr std::size_t count = N;
+    static constexpr const char* glsl = Std140Traits<T>::glsl;
+};
+
+// One reflected member of a block
+struct Std140Field
+{
+    const char* name;
+    const char* glslType;
+    std::size_t arrayCount; // 0 if not an array
+    std::size_t align;
+    std::size_t size;
+    std::size_t offset;     // Where the C++ compiler actually put it
+};
+
+// Walks the fields applying the std140 rules & returns false if any member isn't where std140 expects it.
+template <std::size_t N>
+constexpr bool std140LayoutMatches(const Std140Field (&fields)[N])
+{
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < N; i++)
+    {
+        offset = (offset + fields[i].align - 1) / fields[i].align * fields[i].align;
+        if (fields[i].offset != offset)
+        {
+            return false;
+        }
+        offset += fields[i].size;
+    }
+    return true;
+}
+
+// Filled in by STD140_BLOCK for every block type.
+template <typename T>
+struct Std140Block;
+
+#define STD140_DECLARE(type, name) type name;
+#define STD140_REFLECT(type, name) Std140Field{#name, Std140Traits<type>::glsl, Std140Traits<type>::count, Std140Traits<type>::align, Std140Traits<type>::size, offsetof(Self, name)},
+
+#define STD140_BLOCK(Name, MEMBERS) \
+    struct alignas(16) Name \
+    { \
+        MEMBERS(STD140_DECLARE) \
+    }; \
+    template <> \
+    struct Std140Block<Name> \
+    { \
+        using Self = Name; \
+        static constexpr const char* name = #Name; \
+        static constexpr Std140Field fields[] = { MEMBERS(STD140_REFLECT) }; \
+    }; \
+    static_assert(std140LayoutMatches(Std140Block<Name>::fields), #Name " doesn't match the std140 layout");
+
+template <typename T>
+class UniformBuffer
+{
+public:
+    // Buffer ID & the binding point programs read it from
+    unsigned int ID;
+    unsigned int binding;
+
+    /**
+     * `ringSlots` > 1 makes each update() write to the next slot of a bigger buffer instead of overwriting the one
+     * the GPU may still be reading from last frame, which can make the driver stall or copy the buffer.
+     */
+    UniformBuffer(unsigned int binding, int ringSlots = 1);
+
+    // The one upload per frame. Writes the whole struct & points the binding at it.
+    void update(const T &data);
+
+    // GLSL for this block, e.g. "layout (std140) uniform FrameUniforms { mat4 view; ... };"
+    static std::string glsl();
+
+private:
+    int slots;
+    int current;
+    GLsizeiptr stride;
+};
+
+template <typename T>
+UniformBuffer<T>::UniformBuffer(unsigned int binding, int ringSlots) : binding(binding), slots(ringSlots < 1 ? 1 : ringSlots), current(0)
+{
+    // Every bound range has to start at a multiple of this (usually 256 on desktop)
+    int alignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    stride = ((GLsizeiptr)sizeof(T) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &ID);
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferData(GL_UNIFORM_BUFFER, stride * slots, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ID, 0, sizeof(T));
+}
+
+template <typename T>
+void UniformBuffer<T>::update(const T &data)
+{
+    current = (current + 1) % slots;
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferSubData(GL_UNIFORM_BUFFER, current * stride, sizeof(T), &data);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ID, current * stride, sizeof(T));
+}
+
+template <typename T>
+std::string UniformBuffer<T>::glsl()
+{
+    std::string code = std::string("layout (std140) uniform ") + Std140Block<T>::name + "\n{\n";
+    for (const Std140Field &field : Std140Block<T>::fields)
+    {
+        code += std::string("    ") + field.glslType + " " + field.name;
+        if (field.arrayCount > 0)
+        {
+            code += "[" + std::to_string(field.arrayCount) + "]";
+        }
+        code += ";\n";
+    }
+    return code + "};\n";
+}
+
+/**
+ * Points the program's block called Std140Block<T>::name at `binding`, after checking the linked program agrees
+ * with our struct about the size & every member offset. Prints what's wrong & returns false if not.
+ * A program that doesn't declare the block at all is fine, it just doesn't use that data.
+ */
+template <typename T>
+bool bindUniformBlock(unsigned int program, unsigned int binding)
+{
+    const char* blockName = Std140Block<T>::name;
+    unsigned int blockIndex = glGetUniformBlockIndex(program, blockName);
+    if (blockIndex == GL_INVALID_INDEX)
+    {
+        return false;
+    }
+
+    bool matches = true;
+    int dataSize = 0;
+    glGetActiveUniformBlockiv(program, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+    if ((std::size_t)dataSize > sizeof(T))
+    {
+        std::cout << "ERROR::UNIFORM_BUFFER::SIZE_MISMATCH " << blockName << " is " << dataSize << " bytes in GLSL but " << sizeof(T) << " in C++" << std::endl;
+        matches = false;
+    }
+
+    for (const Std140Field &field : Std140Block<T>::fields)
+    {
+        // Inside a block, members are named without the block name (unless the block has an instance name)
+        std::string memberName = field.arrayCount > 0 ? std::string(field.name) + "[0]" : std::string(field.name);
+        const char* names[] = {memberName.c_str()};
+        unsigned int index = GL_INVALID_INDEX;
+        glGetUniformIndices(program, 1, names, &index);
+        if (index == GL_INVALID_INDEX)
+        {
+            // Unused members get optimised out. Not an error.
+            continue;
+        }
+        int offset = -1;
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+        if (offset != (int)field.offset)
+        {
+            std::cout << "ERROR::UNIFORM_BUFFER::OFFSET_MISMATCH " << blockName << "." << field.name << " is at " << offset << " in GLSL but " << field.offset << " in C++" << std::endl;
+            matches = false;
+        }
+    }
+
+    if (matches)
+    {
+        glUniformBlockBinding(program, blockIndex, binding);
+    }
+    return matches;
+}
+
+#endif